@@ -0,0 +1,237 @@
+#ifndef ARENA_HXX
+#define ARENA_HXX
+
+/*
+Copyright (c) 2014, Markus Brueckner <namenlos@geekbetrieb.de>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither my name nor the names of any contributors may be used to endorse
+      or promote products derived from this software without specific prior
+      written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL I, THE AUTHOR OF THIS SOFTWARE, BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Logging
+{
+    /**
+    * A bump allocator arena for per-message scratch memory. Allocation is a
+    * pointer bump inside the current block; individual deallocation is a
+    * no-op and reset() hands the whole arena back in one go, keeping the
+    * largest block for reuse. After a warm-up message or two a reset arena
+    * serves every following message without touching the heap - unlike
+    * per-message strings and stringstreams, which fragment the global heap
+    * over long runs.
+    *
+    * An arena is not thread safe; use one per thread (see threadArena()) or
+    * per externally synchronized target.
+    */
+    class BumpArena
+    {
+        /// the allocated blocks; mBlocks[mActive] is the one being bumped
+        std::vector<std::pair<std::unique_ptr<char[]>, std::size_t>> mBlocks;
+        std::size_t mActive;
+        std::size_t mOffset;
+
+        void addBlock(std::size_t size)
+        {
+            mBlocks.emplace_back(std::unique_ptr<char[]>(new char[size]), size);
+            mActive = mBlocks.size()-1;
+            mOffset = 0;
+        }
+
+    public:
+
+        /**
+        * Constructor.
+        *
+        * \param initialSize The size of the first block in bytes.
+        */
+        explicit BumpArena(std::size_t initialSize = 4096)
+            : mActive(0), mOffset(0)
+        {
+            addBlock(initialSize);
+        }
+
+        BumpArena(BumpArena const &) = delete;
+        BumpArena &operator=(BumpArena const &) = delete;
+
+        /**
+        * allocate a chunk of memory from the arena. The memory stays valid
+        * until reset() is called; there is no per-chunk deallocation.
+        *
+        * \param bytes The number of bytes to allocate.
+        * \param alignment The required alignment of the chunk.
+        * \return a pointer to the allocated chunk
+        */
+        void *allocate(std::size_t bytes, std::size_t alignment)
+        {
+            std::size_t aligned = (mOffset+alignment-1) & ~(alignment-1);
+            if (aligned+bytes > mBlocks[mActive].second) {
+                // the current block is full - continue in the next one that
+                // fits, or grow by doubling
+                std::size_t largest = 0;
+                for (auto const &block : mBlocks) {
+                    if (block.second > largest) {
+                        largest = block.second;
+                    }
+                }
+                std::size_t newSize = largest*2 > bytes ? largest*2 : bytes;
+                addBlock(newSize);
+                aligned = 0;
+            }
+            mOffset = aligned+bytes;
+            return mBlocks[mActive].first.get()+aligned;
+        }
+
+        /**
+        * hand all allocated memory back to the arena. Everything previously
+        * allocated from it becomes invalid; the largest block is kept, so a
+        * warmed-up arena does not return to the heap.
+        */
+        void reset()
+        {
+            if (mBlocks.size() > 1) {
+                std::size_t largest = 0;
+                for (std::size_t i = 1; i < mBlocks.size(); ++i) {
+                    if (mBlocks[i].second > mBlocks[largest].second) {
+                        largest = i;
+                    }
+                }
+                mBlocks[0] = std::move(mBlocks[largest]);
+                mBlocks.resize(1);
+            }
+            mActive = 0;
+            mOffset = 0;
+        }
+
+        /**
+        * the number of bytes the arena currently holds.
+        *
+        * \return the total size of all blocks
+        */
+        std::size_t capacity() const
+        {
+            std::size_t total = 0;
+            for (auto const &block : mBlocks) {
+                total += block.second;
+            }
+            return total;
+        }
+    };
+
+    /**
+    * the calling thread's arena for per-message scratch memory. The sentry
+    * machinery allocates message spill buffers from it and resets it at the
+    * end of the message; custom targets may use it the same way for their
+    * own per-message buffers.
+    *
+    * \return the arena of the calling thread
+    */
+    inline BumpArena &threadArena()
+    {
+        static thread_local BumpArena arena;
+        return arena;
+    }
+
+    /**
+    * C++11 allocator adapter handing out memory from a BumpArena, for use
+    * with standard containers (see ArenaString below). deallocate() is a
+    * no-op - the memory comes back when the arena is reset.
+    *
+    * \tparam T The element type to allocate.
+    */
+    template <typename T> class ArenaAllocator
+    {
+        BumpArena *mArena;
+
+        template <typename> friend class ArenaAllocator;
+
+    public:
+
+        typedef T value_type;
+        typedef T *pointer;
+        typedef T const *const_pointer;
+        typedef T &reference;
+        typedef T const &const_reference;
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        template <typename U> struct rebind
+        {
+            typedef ArenaAllocator<U> other;
+        };
+
+        /**
+        * Constructor.
+        *
+        * \param arena The arena to allocate from. Defaults to the calling
+        *              thread's arena.
+        */
+        ArenaAllocator(BumpArena &arena = threadArena())
+            : mArena(&arena)
+        {
+        }
+
+        template <typename U> ArenaAllocator(ArenaAllocator<U> const &other)
+            : mArena(other.mArena)
+        {
+        }
+
+        T *allocate(std::size_t n)
+        {
+            return static_cast<T *>(mArena->allocate(n*sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T *, std::size_t)
+        {
+            // bump-allocated memory comes back with the arena reset
+        }
+
+        template <typename U, typename... Args> void construct(U *p, Args&&... args)
+        {
+            ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+        }
+
+        template <typename U> void destroy(U *p)
+        {
+            p->~U();
+        }
+
+        bool operator==(ArenaAllocator const &other) const
+        {
+            return mArena == other.mArena;
+        }
+
+        bool operator!=(ArenaAllocator const &other) const
+        {
+            return mArena != other.mArena;
+        }
+    };
+
+    /// a string allocating from a BumpArena
+    typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+}
+
+#endif // ARENA_HXX
@@ -0,0 +1,361 @@
+#ifndef ASYNCTARGET_HXX
+#define ASYNCTARGET_HXX
+
+/*
+Copyright (c) 2014, Markus Brueckner <namenlos@geekbetrieb.de>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither my name nor the names of any contributors may be used to endorse
+      or promote products derived from this software without specific prior
+      written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL I, THE AUTHOR OF THIS SOFTWARE, BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include "logging.hxx"
+#include "logging_utils.hxx"
+#include "logrecord.hxx"
+
+namespace Logging
+{
+    /**
+    * policy deciding what an AsyncTarget does when its ring buffer is full
+    */
+    enum OverflowPolicy
+    {
+        /// block the logging thread until the consumer has made room
+        OVERFLOW_POLICY_BLOCK,
+        /// drop the message and count it (see AsyncTarget::droppedMessages())
+        OVERFLOW_POLICY_DROP
+    };
+
+    /**
+    * Asynchronous pseudo-target decoupling message production from message
+    * delivery. Logging threads format their message into a thread-local
+    * buffer (no locking at all on the hot path), the finished record is then
+    * pushed into a bounded lock-free multi-producer ring buffer and a
+    * dedicated background thread drains the ring into the wrapped backend
+    * target. Any existing target (OStreamTarget, SyslogTarget, ...) can serve
+    * as the backend; the backend only ever sees a single thread.
+    *
+    * \tparam BackendTarget The target type the background thread delivers the
+    *                      records to.
+    * \note A single thread assembles one message at a time. Interleaving two
+    *       messages from the same thread on the same AsyncTarget (e.g. by
+    *       logging from code called while building a log message) is not
+    *       supported - the same restriction the locking targets have.
+    */
+    template <typename BackendTarget> class AsyncTarget
+    {
+        /**
+        * one slot of the ring buffer. The sequence number implements the
+        * classic bounded MPMC scheme: a slot is free for the producer at
+        * position pos when its sequence equals pos and filled for the
+        * consumer when it equals pos+1.
+        */
+        struct Slot
+        {
+            std::atomic<std::size_t> sequence;
+            LogRecord record;
+        };
+
+        /// per-thread assembly state for the message currently being built
+        struct Assembly
+        {
+            std::ostringstream os;
+            std::string loggerName;
+            unsigned char level;
+            bool isTrace;
+        };
+
+        std::shared_ptr<BackendTarget> mBackend;
+        std::unique_ptr<Slot[]> mSlots;
+        std::size_t mMask;
+        OverflowPolicy mPolicy;
+        std::atomic<std::size_t> mHead;
+        std::size_t mTail;  // only ever touched by the consumer thread
+        std::atomic<unsigned long long> mDropped;
+        std::atomic<bool> mStopped;
+        std::thread mConsumer;
+
+        static Assembly &assembly()
+        {
+            static thread_local Assembly a;
+            return a;
+        }
+
+        /**
+        * try to push a finished record into the ring.
+        *
+        * \return false, if the ring is currently full.
+        */
+        bool tryEnqueue(LogRecord &&record)
+        {
+            std::size_t pos = mHead.load(std::memory_order_relaxed);
+            Slot *slot;
+            for (;;) {
+                slot = &mSlots[pos & mMask];
+                std::size_t seq = slot->sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+                if (diff == 0) {
+                    if (mHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                }
+                else if (diff < 0) {
+                    return false;  // ring is full
+                }
+                else {
+                    pos = mHead.load(std::memory_order_relaxed);
+                }
+            }
+            slot->record = std::move(record);
+            slot->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+        * pop the next record from the ring. Must only be called from the
+        * consumer thread.
+        *
+        * \return false, if the ring is currently empty.
+        */
+        bool tryDequeue(LogRecord &record)
+        {
+            Slot &slot = mSlots[mTail & mMask];
+            std::size_t seq = slot.sequence.load(std::memory_order_acquire);
+            if (static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(mTail + 1) < 0) {
+                return false;  // ring is empty
+            }
+            record = std::move(slot.record);
+            slot.sequence.store(mTail + mMask + 1, std::memory_order_release);
+            ++mTail;
+            return true;
+        }
+
+        /// main loop of the background delivery thread
+        void consume()
+        {
+            LogRecord record;
+            for (;;) {
+                if (tryDequeue(record)) {
+                    deliverRecord(*mBackend, record);
+                }
+                else if (mStopped.load(std::memory_order_acquire)) {
+                    break;  // stopped and drained
+                }
+                else {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+        }
+
+        /// push a finished record into the ring, honoring the overflow policy
+        void submit(LogRecord &&record)
+        {
+            if (mPolicy == OVERFLOW_POLICY_BLOCK) {
+                while (!tryEnqueue(std::move(record))) {
+                    std::this_thread::yield();
+                }
+            }
+            else {
+                if (!tryEnqueue(std::move(record))) {
+                    mDropped.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        /// round the requested capacity up to the next power of two
+        static std::size_t roundUp(std::size_t capacity)
+        {
+            std::size_t n = 1;
+            while (n < capacity) {
+                n <<= 1;
+            }
+            return n;
+        }
+
+    public:
+
+        /**
+        * Constructor.
+        *
+        * \param backend The target the background thread delivers the messages to.
+        * \param capacity The number of messages the ring buffer can hold. Rounded
+        *                 up to the next power of two.
+        * \param policy What to do with new messages, when the ring is full.
+        */
+        AsyncTarget(std::shared_ptr<BackendTarget> const &backend,
+                    std::size_t capacity = 1024,
+                    OverflowPolicy policy = OVERFLOW_POLICY_BLOCK)
+            : mBackend(backend), mSlots(new Slot[roundUp(capacity)]),
+              mMask(roundUp(capacity) - 1), mPolicy(policy),
+              mHead(0), mTail(0), mDropped(0), mStopped(false)
+        {
+            for (std::size_t i = 0; i <= mMask; ++i) {
+                mSlots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            mConsumer = std::thread(&AsyncTarget::consume, this);
+        }
+
+        AsyncTarget(AsyncTarget const &) = delete;
+        AsyncTarget &operator=(AsyncTarget const &) = delete;
+
+        /**
+        * Destructor. Drains all messages still in the ring into the backend
+        * before shutting the delivery thread down.
+        */
+        ~AsyncTarget()
+        {
+            mStopped.store(true, std::memory_order_release);
+            mConsumer.join();
+        }
+
+        /**
+        * Start a message from the given logger with the given level. Unlike
+        * the synchronous targets this does not take any lock - the message is
+        * assembled in a thread-local buffer.
+        *
+        * \param source the logger object, which starts the message.
+        * \param tl the level of this message
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, TraceLevel tl)
+        {
+            Assembly &a = assembly();
+            a.loggerName = source.canonicalName();
+            a.level = tl;
+            a.isTrace = true;
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param ll the level of this message
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, LogLevel ll)
+        {
+            Assembly &a = assembly();
+            a.loggerName = source.canonicalName();
+            a.level = ll;
+            a.isTrace = false;
+        }
+
+        /**
+        * finish a message from the given source. The assembled record is
+        * handed to the ring buffer here; depending on the overflow policy
+        * this either blocks until room is available or drops the message.
+        */
+        template <typename LoggerType> void endMessage(LoggerType const &)
+        {
+            Assembly &a = assembly();
+            LogRecord record { std::move(a.loggerName), a.os.str(), a.level, a.isTrace };
+            a.os.str(std::string());
+            submit(std::move(record));
+        }
+
+        /**
+        * hand a complete, already captured record over (used by the
+        * BufferedLogSentry, see the wantsCompleteRecords flag in the traits).
+        * This skips the thread-local assembly entirely.
+        *
+        * \param source the logger object the record originates from.
+        * \param tl the level of the record
+        * \param data the captured message body
+        * \param size the length of the message body
+        */
+        template <typename LoggerType> void putRecord(LoggerType const &source, TraceLevel tl,
+                                                      char const *data, std::size_t size)
+        {
+            submit(LogRecord { source.canonicalName(), std::string(data, size), static_cast<unsigned char>(tl), true });
+        }
+
+        /**
+        * hand a complete, already captured record over.
+        *
+        * \param source the logger object the record originates from.
+        * \param ll the level of the record
+        * \param data the captured message body
+        * \param size the length of the message body
+        */
+        template <typename LoggerType> void putRecord(LoggerType const &source, LogLevel ll,
+                                                      char const *data, std::size_t size)
+        {
+            submit(LogRecord { source.canonicalName(), std::string(data, size), static_cast<unsigned char>(ll), false });
+        }
+
+        /**
+        * output a value into the thread-local assembly buffer.
+        *
+        * \param v The value. This method has the same effect as <tt>os << v</tt> (with os being the
+        *          assembly buffer of the calling thread).
+        */
+        template <typename LoggerType, typename ValueT> void put(LoggerType const &, ValueT const &v)
+        {
+            assembly().os << v;
+        }
+
+        /**
+        * Output stuff like std::endl into the assembly buffer.
+        *
+        * \param manip The manipulator to output.
+        */
+        void put(std::basic_ostream<char>& (*manip)(std::basic_ostream<char>&))
+        {
+            assembly().os << manip;
+        }
+
+        /**
+        * number of messages dropped so far due to a full ring buffer. Only
+        * ever non-zero with OVERFLOW_POLICY_DROP.
+        *
+        * \return the number of dropped messages
+        */
+        unsigned long long droppedMessages() const
+        {
+            return mDropped.load(std::memory_order_relaxed);
+        }
+    };
+
+    /**
+    * traits specialization for the AsyncTarget. The traits of the wrapped
+    * backend cannot be forwarded in general, so this only promises the
+    * char-output every target supports.
+    */
+    template <typename BackendTarget> struct TargetTraits<AsyncTarget<BackendTarget>>
+    {
+        typedef char char_type;
+        typedef std::char_traits<char> char_traits_type;
+        /// ask the Logger for the record-capturing BufferedLogSentry: the
+        /// whole message arrives as one contiguous putRecord() call instead
+        /// of per-value put()s through the thread-local assembly stream
+        static const bool wantsCompleteRecords = true;
+        /// let messages outgrowing the sentry's inline buffer spill into the
+        /// thread's BumpArena instead of the global heap (see arena.hxx)
+        static const bool wantsArenaBuffers = true;
+    };
+}
+
+#endif // ASYNCTARGET_HXX
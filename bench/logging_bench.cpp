@@ -0,0 +1,199 @@
+/*
+ * Micro-benchmarks for the logging framework. Self-contained (the library
+ * has no external dependencies and no build system, so the suite sticks to
+ * std::chrono timing), built the same way as example.cpp:
+ *
+ *    g++ -std=c++11 -O2 -pthread -I.. -o logging_bench logging_bench.cpp
+ *
+ * Measured:
+ *  - cost of a message compiled against the empty LogSentry shell
+ *    (the "optimized out" claim from the README)
+ *  - cost of a message that is compiled in but filtered by the runtime
+ *    level check
+ *  - single-thread throughput of a null target, OStreamTarget (to a
+ *    /dev/null stream) and - optionally, as it writes to the real syslog,
+ *    compile with -DBENCH_SYSLOG - SyslogTarget
+ *  - multi-threaded scaling of OStreamTarget<std::ostream, std::mutex>
+ *    at 1/4/16/48 threads
+ *
+ * Results are ns per logged message. Run on an idle machine and compare
+ * against a previous build before trusting small differences.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "logging.hxx"
+#include "ostreamtarget.hxx"
+#ifdef BENCH_SYSLOG
+#include "syslogtarget.hxx"
+#endif
+
+namespace
+{
+    /// target swallowing everything - measures the framework overhead alone
+    class NullTarget
+    {
+    public:
+        template <typename LoggerType, typename LevelType> void startMessage(LoggerType const &, LevelType)
+        {
+        }
+
+        template <typename LoggerType> void endMessage(LoggerType const &)
+        {
+        }
+
+        template <typename LoggerType, typename ValueT> void put(LoggerType const &, ValueT const &)
+        {
+        }
+
+        void put(std::basic_ostream<char>& (*)(std::basic_ostream<char>&))
+        {
+        }
+    };
+}
+
+namespace Logging
+{
+    /// traits specialization for the benchmark's null target
+    template <> struct TargetTraits<NullTarget>
+    {
+        typedef char char_type;
+        typedef std::char_traits<char> char_traits_type;
+    };
+}
+
+namespace
+{
+    /// keep the optimizer from removing a computed value
+    template <typename T> inline void doNotOptimize(T const &value)
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    /**
+     * run one benchmark case and print its per-iteration time.
+     *
+     * \param name The label to print.
+     * \param iterations How often to invoke the body.
+     * \param body The code under test; called with the iteration index.
+     */
+    template <typename Body> void run(char const *name, unsigned long iterations, Body body)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < iterations; ++i) {
+            body(i);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now()-start).count();
+        std::cout << std::left << std::setw(48) << name
+                  << std::right << std::setw(10) << elapsed/iterations << " ns/op"
+                  << "   (" << iterations << " iterations)" << std::endl;
+    }
+
+    /**
+     * scaling run: the given number of threads hammer one shared logger.
+     * Reported time is wall time divided by the total message count.
+     */
+    template <typename LoggerT> void runThreaded(char const *name, unsigned threads,
+                                                 unsigned long perThread, std::shared_ptr<LoggerT> logger)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                for (unsigned long i = 0; i < perThread; ++i) {
+                    logger << Logging::LEVEL_INFO << "thread " << t << " message " << i << "\n";
+                }
+            });
+        }
+        for (auto &w : workers) {
+            w.join();
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now()-start).count();
+        std::cout << std::left << std::setw(48) << name
+                  << std::right << std::setw(10) << elapsed/(threads*perThread) << " ns/op"
+                  << "   (" << threads << " threads)" << std::endl;
+    }
+}
+
+int main()
+{
+    unsigned long const N = 10000000;
+
+    // --- sentry overhead ---------------------------------------------------
+    {
+        // trace == false: DEBUG messages hit the empty LogSentry shell
+        typedef Logging::Logger<NullTarget, false> Logger;
+        auto target = std::make_shared<NullTarget>();
+        auto logger = std::make_shared<Logger>(target, "bench");
+        run("disabled sentry (empty shell, DEBUG)", N, [&](unsigned long i) {
+            logger << Logging::LEVEL_DEBUG << "value " << i;
+            doNotOptimize(i);
+        });
+    }
+    {
+        // compiled in, but filtered by the runtime level comparison
+        typedef Logging::Logger<NullTarget, true> Logger;
+        auto target = std::make_shared<NullTarget>();
+        auto logger = std::make_shared<Logger>(target, "bench");
+        logger->setLevel(Logging::LEVEL_ERROR);
+        run("runtime-filtered message (INFO below ERROR)", N, [&](unsigned long i) {
+            logger << Logging::LEVEL_INFO << "value " << i;
+            doNotOptimize(i);
+        });
+    }
+
+    // --- single-thread target throughput ------------------------------------
+    {
+        typedef Logging::Logger<NullTarget, true> Logger;
+        auto target = std::make_shared<NullTarget>();
+        auto logger = std::make_shared<Logger>(target, "bench");
+        run("null target throughput", N/10, [&](unsigned long i) {
+            logger << Logging::LEVEL_INFO << "message " << i << "\n";
+        });
+    }
+    {
+        typedef Logging::OStreamTarget<std::ostream> Target;
+        typedef Logging::Logger<Target, true> Logger;
+        std::ofstream sink("/dev/null");
+        auto target = std::make_shared<Target>(sink);
+        auto logger = std::make_shared<Logger>(target, "bench");
+        run("OStreamTarget throughput (/dev/null)", N/10, [&](unsigned long i) {
+            logger << Logging::LEVEL_INFO << "message " << i << "\n";
+        });
+    }
+#ifdef BENCH_SYSLOG
+    {
+        typedef Logging::SyslogTarget<> Target;
+        typedef Logging::Logger<Target, true> Logger;
+        auto target = std::make_shared<Target>();
+        auto logger = std::make_shared<Logger>(target, "logging_bench");
+        run("SyslogTarget throughput", 100000, [&](unsigned long i) {
+            logger << Logging::LEVEL_INFO << "message " << i;
+        });
+    }
+#endif
+
+    // --- multi-threaded scaling ---------------------------------------------
+    {
+        typedef Logging::OStreamTarget<std::ostream, std::mutex> Target;
+        typedef Logging::Logger<Target, true> Logger;
+        std::ofstream sink("/dev/null");
+        auto target = std::make_shared<Target>(sink);
+        auto logger = std::make_shared<Logger>(target, "bench");
+        runThreaded("OStreamTarget<_, std::mutex>  1 thread", 1, 1000000, logger);
+        runThreaded("OStreamTarget<_, std::mutex>  4 threads", 4, 250000, logger);
+        runThreaded("OStreamTarget<_, std::mutex> 16 threads", 16, 62500, logger);
+        runThreaded("OStreamTarget<_, std::mutex> 48 threads", 48, 20834, logger);
+    }
+
+    return 0;
+}
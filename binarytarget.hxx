@@ -0,0 +1,272 @@
+#ifndef BINARYTARGET_HXX
+#define BINARYTARGET_HXX
+
+/*
+Copyright (c) 2014, Markus Brueckner <namenlos@geekbetrieb.de>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither my name nor the names of any contributors may be used to endorse
+      or promote products derived from this software without specific prior
+      written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL I, THE AUTHOR OF THIS SOFTWARE, BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "logging.hxx"
+#include "locking.hxx"
+
+namespace Logging
+{
+    /**
+    * Logging target writing compact binary records instead of text. Text
+    * formatting of values (iostream operator<< for ints, doubles, ...) is by
+    * far the most expensive part of a log statement; this target skips it
+    * entirely on the hot path and memcpys the raw, type-tagged values into
+    * the record. All human-readable formatting is deferred to the offline
+    * reader (binlogreader.cpp, shipped alongside).
+    *
+    * Record format (host endianness, see binlogreader.cpp for the decoder):
+    *
+    *    'N' u32 loggerId  u16 nameLength  name-bytes         logger name definition
+    *    'M' u32 loggerId  u64 timestampMs u8 level u8 trace  start of a message
+    *    'i' i64 / 'u' u64 / 'd' double / 'c' char            raw values
+    *    's' u32 length    bytes                              string value
+    *    'E'                                                  end of a message
+    *
+    * A logger name definition is emitted once per logger, the first time the
+    * logger writes to this target; messages reference the name by id only.
+    *
+    * \tparam LockType The type of Lock adapter to use. See OStreamTarget for the requirements.
+    */
+    template <typename LockType = NullLock> class BinaryTarget : public LockType
+    {
+        int mFd;
+        bool mOwnsFd;
+        std::string mBuffer;
+        /// ids of all loggers that wrote to this target so far, keyed by the
+        /// logger's address (the same scheme SyslogTarget uses for its names)
+        std::map<void const *, std::uint32_t> mLoggerIds;
+
+        /// append the raw bytes of a value to the record buffer
+        template <typename RawT> void appendRaw(RawT const &v)
+        {
+            mBuffer.append(reinterpret_cast<char const *>(&v), sizeof(v));
+        }
+
+        /**
+        * look the id of the given logger up, emitting a name definition
+        * record on its first appearance.
+        */
+        template <typename LoggerType> std::uint32_t loggerId(LoggerType const *l)
+        {
+            auto i = mLoggerIds.find(l);
+            if (i == mLoggerIds.end()) {
+                std::uint32_t id = static_cast<std::uint32_t>(mLoggerIds.size());
+                i = mLoggerIds.insert(std::make_pair(static_cast<void const *>(l), id)).first;
+                std::string const &name = l->canonicalName();
+                mBuffer += 'N';
+                appendRaw(id);
+                appendRaw(static_cast<std::uint16_t>(name.size()));
+                mBuffer += name;
+            }
+            return i->second;
+        }
+
+        /// write the message header for the given source and numeric level
+        template <typename LoggerType> void startRecord(LoggerType const &source, unsigned char level, bool isTrace)
+        {
+            std::uint32_t id = loggerId(&source);
+            auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::system_clock::now().time_since_epoch()).count();
+            mBuffer += 'M';
+            appendRaw(id);
+            appendRaw(static_cast<std::uint64_t>(millis));
+            appendRaw(static_cast<std::uint8_t>(level));
+            appendRaw(static_cast<std::uint8_t>(isTrace ? 1 : 0));
+        }
+
+    public:
+
+        /**
+        * Constructor wrapping an already opened file descriptor.
+        *
+        * \param fd The file descriptor to write the records to. The caller
+        *           keeps ownership of the descriptor.
+        */
+        explicit BinaryTarget(int fd)
+            : mFd(fd), mOwnsFd(false)
+        {
+        }
+
+        /**
+        * Constructor opening (and owning) a log file.
+        *
+        * \param fileName The file to append the records to. Created if necessary.
+        */
+        explicit BinaryTarget(char const *fileName)
+            : mFd(::open(fileName, O_WRONLY|O_CREAT|O_APPEND, 0644)), mOwnsFd(true)
+        {
+            if (mFd < 0) {
+                throw std::runtime_error(std::string("could not open binary log file ")+fileName);
+            }
+        }
+
+        BinaryTarget(BinaryTarget const &) = delete;
+        BinaryTarget &operator=(BinaryTarget const &) = delete;
+
+        ~BinaryTarget()
+        {
+            if (mOwnsFd && mFd >= 0) {
+                ::close(mFd);
+            }
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param tl the level of this message
+        * \note This method calls LockType::lock(). It might therefore block until the lock is available.
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, TraceLevel tl)
+        {
+            LockType::lock();
+            startRecord(source, tl, true);
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param ll the level of this message
+        * \note This method calls LockType::lock(). It might therefore block until the lock is available.
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, LogLevel ll)
+        {
+            LockType::lock();
+            startRecord(source, ll, false);
+        }
+
+        /**
+        * finish a message from the given source. The complete record is
+        * written to the file descriptor with a single write().
+        */
+        template <typename LoggerType> void endMessage(LoggerType const &)
+        {
+            mBuffer += 'E';
+            auto written = ::write(mFd, mBuffer.data(), mBuffer.size());
+            (void)written;  // a full disk is not worth throwing out of a log statement
+            mBuffer.clear();
+            LockType::unlock();
+        }
+
+        /// output a signed integral value as a raw 8-byte record
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<std::is_integral<ValueT>::value && std::is_signed<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            mBuffer += 'i';
+            appendRaw(static_cast<std::int64_t>(v));
+        }
+
+        /// output an unsigned integral value as a raw 8-byte record
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<std::is_integral<ValueT>::value && std::is_unsigned<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            mBuffer += 'u';
+            appendRaw(static_cast<std::uint64_t>(v));
+        }
+
+        /// output a floating point value as a raw double record
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<std::is_floating_point<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            mBuffer += 'd';
+            appendRaw(static_cast<double>(v));
+        }
+
+        /// output a single character
+        template <typename LoggerType> void put(LoggerType const &, char const &v)
+        {
+            mBuffer += 'c';
+            mBuffer += v;
+        }
+
+        /// output a length-prefixed C string
+        template <typename LoggerType> void put(LoggerType const &, char const * const &v)
+        {
+            mBuffer += 's';
+            appendRaw(static_cast<std::uint32_t>(std::strlen(v)));
+            mBuffer += v;
+        }
+
+        /// output a length-prefixed string
+        template <typename LoggerType> void put(LoggerType const &, std::string const &v)
+        {
+            mBuffer += 's';
+            appendRaw(static_cast<std::uint32_t>(v.size()));
+            mBuffer += v;
+        }
+
+        /**
+        * output any other value. Types without a raw representation are
+        * formatted to text once and stored as a string record.
+        */
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<!std::is_arithmetic<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            std::ostringstream os;
+            os << v;
+            put(0, os.str());
+        }
+
+        /**
+        * Manipulators like std::endl have no meaning in a binary record -
+        * records are framed explicitly - and are therefore ignored.
+        */
+        void put(std::basic_ostream<char>& (*)(std::basic_ostream<char>&))
+        {
+        }
+    };
+
+    /**
+     * traits specialization for the BinaryTarget
+     */
+    template <typename LockType> struct TargetTraits<BinaryTarget<LockType>>
+    {
+        typedef char char_type;
+        typedef std::char_traits<char> char_traits_type;
+    };
+}
+#endif // BINARYTARGET_HXX
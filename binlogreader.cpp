@@ -0,0 +1,156 @@
+/*
+ * Offline reader for log files written by the BinaryTarget (see
+ * binarytarget.hxx for the record format). The BinaryTarget defers all
+ * human-readable formatting to this tool, which turns the records back
+ * into the familiar text form:
+ *
+ *    <timestamp> (logger::name) [LEVEL] message values
+ *
+ * build e.g. with: g++ -std=c++11 -O2 -o binlogreader binlogreader.cpp
+ * usage: binlogreader <logfile>
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "logging.hxx"
+#include "logging_utils.hxx"
+
+namespace
+{
+    /// cursor over the raw file contents
+    struct Reader
+    {
+        std::vector<char> data;
+        std::size_t pos = 0;
+
+        bool atEnd() const
+        {
+            return pos >= data.size();
+        }
+
+        /// bail out cleanly if fewer than n bytes are left - a crashed
+        /// writer leaves a truncated final record, not a corrupt file
+        void require(std::size_t n) const
+        {
+            if (n > data.size()-pos) {
+                std::cerr << "truncated record at offset " << pos << std::endl;
+                std::exit(1);
+            }
+        }
+
+        char tag()
+        {
+            require(1);
+            return data[pos++];
+        }
+
+        template <typename RawT> RawT raw()
+        {
+            RawT v;
+            require(sizeof(v));
+            std::memcpy(&v, &data[pos], sizeof(v));
+            pos += sizeof(v);
+            return v;
+        }
+
+        std::string bytes(std::size_t n)
+        {
+            require(n);
+            std::string s(&data[pos], n);
+            pos += n;
+            return s;
+        }
+    };
+
+    void printTimestamp(std::uint64_t millis)
+    {
+        std::time_t seconds = static_cast<std::time_t>(millis/1000);
+        char buf[64];
+        std::strftime(buf, sizeof(buf), "%F %T", std::localtime(&seconds));
+        char ms[5] = { '.',
+                       static_cast<char>('0'+(millis/100)%10),
+                       static_cast<char>('0'+(millis/10)%10),
+                       static_cast<char>('0'+millis%10), '\0' };
+        std::cout << '<' << buf << ms << "> ";
+    }
+
+    char const *levelName(std::uint8_t level, bool isTrace)
+    {
+        if (isTrace) {
+            return Logging::levelName(static_cast<Logging::TraceLevel>(level));
+        }
+        return Logging::levelName(static_cast<Logging::LogLevel>(level));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        std::cerr << "usage: " << argv[0] << " <logfile>" << std::endl;
+        return 1;
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file) {
+        std::cerr << "could not open " << argv[1] << std::endl;
+        return 1;
+    }
+    Reader reader;
+    reader.data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    std::map<std::uint32_t, std::string> loggerNames;
+    while (!reader.atEnd()) {
+        switch (reader.tag()) {
+        case 'N': {
+            auto id = reader.raw<std::uint32_t>();
+            auto length = reader.raw<std::uint16_t>();
+            loggerNames[id] = reader.bytes(length);
+            break;
+        }
+        case 'M': {
+            auto id = reader.raw<std::uint32_t>();
+            auto millis = reader.raw<std::uint64_t>();
+            auto level = reader.raw<std::uint8_t>();
+            auto isTrace = reader.raw<std::uint8_t>() != 0;
+            printTimestamp(millis);
+            std::string const &name = loggerNames[id];
+            if (name.size() > 0) {
+                std::cout << '(' << name << ") ";
+            }
+            std::cout << '[' << levelName(level, isTrace) << "] ";
+            break;
+        }
+        case 'i':
+            std::cout << reader.raw<std::int64_t>();
+            break;
+        case 'u':
+            std::cout << reader.raw<std::uint64_t>();
+            break;
+        case 'd':
+            std::cout << reader.raw<double>();
+            break;
+        case 'c':
+            std::cout << reader.tag();
+            break;
+        case 's': {
+            auto length = reader.raw<std::uint32_t>();
+            std::cout << reader.bytes(length);
+            break;
+        }
+        case 'E':
+            std::cout << std::endl;
+            break;
+        default:
+            std::cerr << "corrupt record at offset " << reader.pos-1 << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+#ifndef CRASHLOG_HXX
+#define CRASHLOG_HXX
+
+/*
+Copyright (c) 2014, Markus Brueckner <namenlos@geekbetrieb.de>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither my name nor the names of any contributors may be used to endorse
+      or promote products derived from this software without specific prior
+      written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL I, THE AUTHOR OF THIS SOFTWARE, BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstddef>
+#include <cstring>
+
+#include <errno.h>
+#include <unistd.h>
+
+namespace Logging
+{
+    /**
+    * Crash logging channel for signal handlers. The regular targets are
+    * unusable there: they take locks, allocate and call localtime() - any
+    * of which can deadlock or corrupt state when the signal interrupted the
+    * wrong instruction. A CrashLog is the opposite: everything that is not
+    * signal-safe (choosing the descriptor, formatting the message prefix)
+    * happens once in prepare() at startup into a preallocated buffer, and
+    * fatalWrite() - the only thing the signal handler calls - is nothing but
+    * raw write(2)s of already captured bytes. No locks, no allocation, no
+    * formatting, bounded time.
+    *
+    * Typical use:
+    * \code
+    *     Logging::CrashLog::instance().prepare("[FATAL] myservice crashed: ", fd);
+    *     // ... in the signal handler:
+    *     Logging::CrashLog::instance().fatalWrite("segmentation fault\n");
+    * \endcode
+    */
+    class CrashLog
+    {
+        int mFd;
+        char mPrefix[256];
+        std::size_t mPrefixLength;
+
+        /// write(2) everything, restarting on EINTR. Async-signal-safe.
+        static void writeAll(int fd, char const *data, std::size_t size)
+        {
+            while (size > 0) {
+                ssize_t written = ::write(fd, data, size);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return;  // nothing sensible left to do in a crash handler
+                }
+                data += written;
+                size -= static_cast<std::size_t>(written);
+            }
+        }
+
+    public:
+
+        CrashLog()
+            : mFd(STDERR_FILENO), mPrefixLength(0)
+        {
+        }
+
+        /**
+        * set up the crash channel. NOT async-signal-safe - call this once at
+        * startup, before installing the signal handlers.
+        *
+        * \param prefix Text written in front of every crash message (process
+        *               name, "[FATAL]" tag, ...). Truncated to the internal
+        *               buffer size; may be nullptr for no prefix.
+        * \param fd The descriptor crash messages are written to. Pass the
+        *           descriptor of an already opened crash file to keep crash
+        *           output out of stderr.
+        */
+        void prepare(char const *prefix, int fd = STDERR_FILENO)
+        {
+            mFd = fd;
+            mPrefixLength = 0;
+            if (prefix) {
+                std::size_t length = std::strlen(prefix);
+                if (length > sizeof(mPrefix)) {
+                    length = sizeof(mPrefix);
+                }
+                std::memcpy(mPrefix, prefix, length);
+                mPrefixLength = length;
+            }
+        }
+
+        /**
+        * write a crash message: the prepared prefix followed by the given
+        * bytes. Async-signal-safe; runs in bounded time and touches neither
+        * locks nor the heap. The bytes are written as captured - format them
+        * at call-preparation time, not in the handler.
+        *
+        * \param text The message bytes.
+        * \param length The number of bytes to write.
+        */
+        void fatalWrite(char const *text, std::size_t length) const
+        {
+            if (mPrefixLength > 0) {
+                writeAll(mFd, mPrefix, mPrefixLength);
+            }
+            writeAll(mFd, text, length);
+        }
+
+        /**
+        * write a crash message given as a NUL-terminated string.
+        * Async-signal-safe (strlen is).
+        *
+        * \param text The message.
+        */
+        void fatalWrite(char const *text) const
+        {
+            fatalWrite(text, std::strlen(text));
+        }
+
+        /**
+        * the process-wide crash channel. Signal handlers cannot carry
+        * context, so this is deliberately a plain global instance -
+        * constructed before main() and never destroyed while handlers can
+        * still fire.
+        *
+        * \return the process-wide CrashLog
+        */
+        static CrashLog &instance()
+        {
+            static CrashLog crashLog;
+            return crashLog;
+        }
+    };
+}
+
+#endif // CRASHLOG_HXX
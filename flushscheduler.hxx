@@ -0,0 +1,273 @@
+#ifndef FLUSHSCHEDULER_HXX
+#define FLUSHSCHEDULER_HXX
+
+/*
+Copyright (c) 2014, Markus Brueckner <namenlos@geekbetrieb.de>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither my name nor the names of any contributors may be used to endorse
+      or promote products derived from this software without specific prior
+      written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL I, THE AUTHOR OF THIS SOFTWARE, BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Logging
+{
+    /**
+    * Periodic flusher for deployments with many targets. With one buffered
+    * file target per tenant, flushing is otherwise left to whichever
+    * request thread happens to trigger the stream's internal buffer limit -
+    * and with a few hundred files that turns into periodic flush storms
+    * stalling that thread. A FlushScheduler moves the flushing to a small
+    * worker pool instead: attached targets are flushed once per interval,
+    * the flush jobs of a round are dealt round-robin onto per-worker queues,
+    * and a worker that drains its own queue steals from its siblings - so
+    * one slow file (a cold NFS mount, say) does not hold up the flushing of
+    * the other tenants, and no request thread ever blocks in a flush.
+    *
+    * Anything with a flush() member can be attached; plain callables work
+    * too, for targets that need custom flushing:
+    *
+    * \code
+    *     Logging::FlushScheduler scheduler(2, std::chrono::milliseconds(200));
+    *     auto ticket = scheduler.attach(batchedTarget);           // calls flush()
+    *     scheduler.attach([&stream]() { stream.flush(); });       // custom
+    *     ...
+    *     scheduler.detach(ticket);  // before the target dies
+    * \endcode
+    *
+    * The BatchedOStreamTarget attaches itself when constructed with a
+    * scheduler reference; manual attach()/detach() is for everything else.
+    * Detach before the attached object is destroyed - detach() waits for a
+    * flush of that object that is already running.
+    */
+    class FlushScheduler
+    {
+    public:
+
+        /// handle identifying an attached flush job; 0 is never issued
+        typedef std::size_t Ticket;
+
+    private:
+
+        std::mutex mMutex;
+        std::condition_variable mCondition;
+        /// all attached jobs by ticket
+        std::map<Ticket, std::function<void()>> mJobs;
+        /// per-worker queues of the current round. Own queue is popped from
+        /// the front, stealing happens from the back.
+        std::vector<std::deque<Ticket>> mQueues;
+        /// the ticket each worker is currently flushing (0 = idle)
+        std::vector<Ticket> mRunning;
+        std::vector<std::thread> mWorkers;
+        std::chrono::steady_clock::time_point mNextRound;
+        std::chrono::steady_clock::duration mInterval;
+        Ticket mNextTicket;
+        bool mStop;
+
+        /// deal the attached jobs round-robin onto the worker queues.
+        /// Must be called with the lock held.
+        void dealRound()
+        {
+            std::size_t worker = 0;
+            for (auto const &job : mJobs) {
+                mQueues[worker].push_back(job.first);
+                worker = (worker+1) % mQueues.size();
+            }
+            mNextRound = std::chrono::steady_clock::now()+mInterval;
+        }
+
+        /**
+        * run one flush job: the front of the own queue if there is one,
+        * otherwise one stolen from the back of a sibling's queue. The flush
+        * itself runs without the lock. Must be called with the lock held.
+        *
+        * \param self The index of the calling worker.
+        * \param lock The held lock, released around the flush call.
+        * \return true, if a job was run; false, if all queues were empty.
+        */
+        bool runOneJob(std::size_t self, std::unique_lock<std::mutex> &lock)
+        {
+            for (std::size_t i = 0; i < mQueues.size(); ++i) {
+                std::deque<Ticket> &queue = mQueues[(self+i) % mQueues.size()];
+                if (queue.empty()) {
+                    continue;
+                }
+                Ticket ticket;
+                if (i == 0) {
+                    ticket = queue.front();
+                    queue.pop_front();
+                }
+                else {  // steal from the cold end
+                    ticket = queue.back();
+                    queue.pop_back();
+                }
+                auto job = mJobs.find(ticket);
+                if (job == mJobs.end()) {
+                    return true;  // detached since the round was dealt
+                }
+                std::function<void()> flush = job->second;
+                mRunning[self] = ticket;
+                lock.unlock();
+                flush();
+                lock.lock();
+                mRunning[self] = 0;
+                mCondition.notify_all();  // a detach() may wait for this job
+                return true;
+            }
+            return false;
+        }
+
+        void workerLoop(std::size_t self)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            while (!mStop) {
+                if (runOneJob(self, lock)) {
+                    continue;
+                }
+                if (mCondition.wait_until(lock, mNextRound) == std::cv_status::timeout
+                    && !mStop && std::chrono::steady_clock::now() >= mNextRound) {
+                    // first worker past the deadline starts the next round
+                    dealRound();
+                    mCondition.notify_all();
+                }
+            }
+        }
+
+        /// register a job under a fresh ticket and return it
+        Ticket attachJob(std::function<void()> job)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            Ticket ticket = mNextTicket++;
+            mJobs[ticket] = std::move(job);
+            return ticket;
+        }
+
+    public:
+
+        /**
+        * Constructor. Starts the worker pool.
+        *
+        * \param workerCount The number of flush workers. A handful suffices
+        *                    for hundreds of targets - the pool only has to
+        *                    keep up with the flush interval, not with the
+        *                    message rate.
+        * \param interval How often each attached target is flushed.
+        */
+        FlushScheduler(std::size_t workerCount = 2,
+                       std::chrono::milliseconds interval = std::chrono::milliseconds(1000))
+            : mQueues(workerCount > 0 ? workerCount : 1),
+              mRunning(workerCount > 0 ? workerCount : 1, 0),
+              mNextRound(std::chrono::steady_clock::now()+interval),
+              mInterval(interval), mNextTicket(1), mStop(false)
+        {
+            for (std::size_t i = 0; i < mQueues.size(); ++i) {
+                mWorkers.emplace_back(&FlushScheduler::workerLoop, this, i);
+            }
+        }
+
+        /**
+        * Destructor. Stops the workers; a flush in progress is finished,
+        * queued-but-not-started flushes of the current round are dropped.
+        * Attached targets are NOT flushed a final time - they flush
+        * themselves on destruction, as before.
+        */
+        ~FlushScheduler()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mStop = true;
+            }
+            mCondition.notify_all();
+            for (auto &worker : mWorkers) {
+                worker.join();
+            }
+        }
+
+        FlushScheduler(FlushScheduler const &) = delete;
+        FlushScheduler &operator=(FlushScheduler const &) = delete;
+
+        /**
+        * attach a target. Its flush() is called once per interval from a
+        * worker thread, concurrently with whatever the logging threads are
+        * doing - the target's flush() must therefore be internally
+        * synchronized. For the targets in this library that means a real
+        * LockType (std::mutex, not the NullLock), even when only a single
+        * thread logs.
+        *
+        * \param target The target to flush periodically. Must stay alive
+        *               until detach() of the returned ticket.
+        * \return the ticket to detach() the target with
+        */
+        template <typename TargetT> Ticket attach(TargetT &target)
+        {
+            TargetT *t = &target;
+            return attachJob([t]() { t->flush(); });
+        }
+
+        /**
+        * attach a custom flush action for targets without a flush() member
+        * (an OStreamTarget over a file stream, for instance).
+        *
+        * \param job The action to run once per interval.
+        * \return the ticket to detach() the action with
+        */
+        Ticket attach(std::function<void()> job)
+        {
+            return attachJob(std::move(job));
+        }
+
+        /**
+        * detach a previously attached target. Blocks until a flush of that
+        * target that is already running has finished - after detach()
+        * returns, the scheduler holds no reference to the target and it may
+        * be destroyed.
+        *
+        * \param ticket The ticket attach() returned.
+        */
+        void detach(Ticket ticket)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mJobs.erase(ticket);
+            for (bool running = true; running; ) {
+                running = false;
+                for (Ticket current : mRunning) {
+                    if (current == ticket) {
+                        running = true;
+                        mCondition.wait(lock);
+                        break;
+                    }
+                }
+            }
+        }
+    };
+}
+
+#endif // FLUSHSCHEDULER_HXX
@@ -31,6 +31,18 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <string>
 #include <map>
 #include <memory>
+#include <stdexcept>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+#include <cstdio>
+#include <cstring>
+
+#include "arena.hxx"
 
 namespace Logging {
     /**
@@ -61,6 +73,84 @@ namespace Logging {
 #define TRACING true
 #endif
 
+/*
+ * Branch hints and a cold-function annotation for the per-message enabled
+ * checks. In production builds most DEBUG/INFO messages are disabled, so the
+ * hot path through a logging call site is "compare, branch over a cold call,
+ * continue" - the sentry and target machinery should neither be predicted as
+ * taken nor inflate the caller's instruction stream.
+ */
+#if defined(__GNUC__)
+#define LOGGING_LIKELY(x)   __builtin_expect(!!(x), 1)
+#define LOGGING_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#define LOGGING_COLD        __attribute__((noinline, cold))
+#else
+#define LOGGING_LIKELY(x)   (x)
+#define LOGGING_UNLIKELY(x) (x)
+#define LOGGING_COLD
+#endif
+
+    namespace detail
+    {
+        /// C++11 stand-in for std::void_t
+        template <typename...> struct MakeVoid
+        {
+            typedef void type;
+        };
+
+        /**
+        * detect whether a traits type declares wantsArenaBuffers (and sets
+        * it to true). Targets use this flag to route the BufferedLogSentry's
+        * spill buffer through the calling thread's BumpArena instead of the
+        * global heap; the arena is reset when the message is delivered.
+        */
+        template <typename Traits, typename = void> struct WantsArenaBuffers
+        {
+            static const bool value = false;
+        };
+
+        template <typename Traits> struct WantsArenaBuffers<Traits,
+                typename MakeVoid<decltype(Traits::wantsArenaBuffers)>::type>
+        {
+            static const bool value = Traits::wantsArenaBuffers;
+        };
+
+        /**
+        * detect whether a traits type declares wantsLoggerName. Targets
+        * branch on this compile-time constant when building the message
+        * prefix, so a Logger typedef whose traits set it to false has the
+        * whole "(name) " formatting removed by the compiler - like the
+        * TRACE elision, not just skipped at run time. Defaults to true:
+        * traits without the member keep the full prefix.
+        */
+        template <typename Traits, typename = void> struct WantsLoggerName
+        {
+            static const bool value = true;
+        };
+
+        template <typename Traits> struct WantsLoggerName<Traits,
+                typename MakeVoid<decltype(Traits::wantsLoggerName)>::type>
+        {
+            static const bool value = Traits::wantsLoggerName;
+        };
+
+        /**
+        * detect whether a traits type declares wantsTimestamp. Works like
+        * WantsLoggerName, but strips the timestamp formatting (including the
+        * localtime/strftime machinery) from the prefix. Defaults to true.
+        */
+        template <typename Traits, typename = void> struct WantsTimestamp
+        {
+            static const bool value = true;
+        };
+
+        template <typename Traits> struct WantsTimestamp<Traits,
+                typename MakeVoid<decltype(Traits::wantsTimestamp)>::type>
+        {
+            static const bool value = Traits::wantsTimestamp;
+        };
+    }
+
     /**
     * Log sentry object guarding start and finish of a log message
     *
@@ -76,12 +166,36 @@ namespace Logging {
         typename LoggerType
         > class LogSentry
     {
-        template <typename TargetType, bool trace, typename TargetTraits> friend class Logger;
+        template <typename TargetType, bool trace, typename TargetTraits, unsigned char minCompiledLevel> friend class Logger;
 
-        Target &mTarget;
+        /// the target snapshot this message goes to. Holding the shared_ptr
+        /// (not a plain reference) keeps the target alive for the duration of
+        /// the message even when another thread concurrently calls setTarget.
+        std::shared_ptr<Target> mTarget;
         LoggerType const &mSource;
         bool mEnabled;
 
+        /*
+         * the out-of-line continuations of the enabled path. Keeping them
+         * cold means a call site whose message is disabled only inlines the
+         * level compare and a branch over a call, not the whole target
+         * machinery.
+         */
+        LOGGING_COLD void begin(TraceLevel tl)
+        {
+            mTarget->startMessage(mSource, tl);
+        }
+
+        LOGGING_COLD void begin(LogLevel ll)
+        {
+            mTarget->startMessage(mSource, ll);
+        }
+
+        LOGGING_COLD void finish()
+        {
+            mTarget->endMessage(mSource);
+        }
+
         /**
         * constructor for starting a log message with a trace level
         *
@@ -90,11 +204,11 @@ namespace Logging {
         * \param tl The trace level of this message
         * \param enabled indicates, whether the sentry should actually output a message
         */
-        LogSentry(Target &target, LoggerType const &source, TraceLevel tl, bool enabled)
-            : mTarget(target), mSource { source }, mEnabled { enabled }
+        LogSentry(std::shared_ptr<Target> target, LoggerType const &source, TraceLevel tl, bool enabled)
+            : mTarget(std::move(target)), mSource { source }, mEnabled { enabled }
         {
-            if (enabled) {
-                mTarget.startMessage(source, tl);
+            if (LOGGING_UNLIKELY(enabled)) {
+                begin(tl);
             }
         }
 
@@ -106,11 +220,11 @@ namespace Logging {
         * \param ll The log level of this message
         * \param enabled flag indicating, whether the output of this sentry is actually enabled
         */
-        LogSentry(Target &target, LoggerType const &source, LogLevel ll, bool enabled)
-            : mTarget(target), mSource { source }, mEnabled { enabled }
+        LogSentry(std::shared_ptr<Target> target, LoggerType const &source, LogLevel ll, bool enabled)
+            : mTarget(std::move(target)), mSource { source }, mEnabled { enabled }
         {
-            if (enabled) {
-                mTarget.startMessage(source, ll);
+            if (LOGGING_UNLIKELY(enabled)) {
+                begin(ll);
             }
         }
 
@@ -120,20 +234,24 @@ namespace Logging {
 
         ~LogSentry()
         {
-            if (mEnabled) {
-                mTarget.endMessage(mSource);
+            if (LOGGING_UNLIKELY(mEnabled)) {
+                finish();
             }
         }
 
         /**
-        * Output a value to the logger.
+        * Output a value to the logger. The value's category is preserved on
+        * the way to the target: a temporary built inline (the common
+        * <tt>sentry << buildKey(a, b)</tt> pattern) reaches the target's
+        * put() as an rvalue, so targets providing rvalue overloads can move
+        * from it instead of copying.
         *
         * \param v The value to output.
         */
-        template <typename ValueT> inline LogSentry &operator<<(ValueT const &v)
+        template <typename ValueT> inline LogSentry &operator<<(ValueT &&v)
         {
-            if (mEnabled) {
-                mTarget.put(mSource, v);
+            if (LOGGING_UNLIKELY(mEnabled)) {
+                mTarget->put(mSource, std::forward<ValueT>(v));
             }
             return *this;
         }
@@ -148,8 +266,8 @@ namespace Logging {
                                                     std::basic_ostream<typename LoggerType::TargetTraitsType::char_type,
                                                     typename LoggerType::TargetTraitsType::char_traits_type> &))
         {
-            if (mEnabled) {
-                mTarget.put(mSource, manip);
+            if (LOGGING_UNLIKELY(mEnabled)) {
+                mTarget->put(mSource, manip);
             }
             return *this;
         }
@@ -164,17 +282,21 @@ namespace Logging {
         typename LoggerType
         > class LogSentry<Target, false, LoggerType>
     {
-        template <typename TargetType, bool trace, typename TargetTraits> friend class Logger;
+        template <typename TargetType, bool trace, typename TargetTraits, unsigned char minCompiledLevel> friend class Logger;
 
         /**
         * constructor for starting a log message with a trace level
-        *
-        * \internal
-        *            This class only needs the trace level constructor, as it will never be created with
-        *            a log level input
-        * \endinternal
         */
-        LogSentry(Target &, LoggerType const &, TraceLevel, bool)
+        LogSentry(std::shared_ptr<Target> const &, LoggerType const &, TraceLevel, bool)
+        {
+        }
+
+        /**
+        * constructor for starting a log message with a log level. Used when
+        * the compile-time minimum level of the logger removes even the
+        * regular log levels.
+        */
+        LogSentry(std::shared_ptr<Target> const &, LoggerType const &, LogLevel, bool)
         {
         }
 
@@ -184,7 +306,7 @@ namespace Logging {
         /**
          * output anything. This method is just an empty shell to be optimized away.
          */
-        template <typename ValueT> inline LogSentry &operator<<(ValueT const &)
+        template <typename ValueT> inline LogSentry &operator<<(ValueT &&)
         {
             return *this;
         }
@@ -201,12 +323,405 @@ namespace Logging {
         }
     };
 
+    /**
+    * Alternative sentry capturing the whole message into a small stack
+    * buffer (spilling to the heap only for oversized messages) and handing
+    * the target one contiguous record in the destructor via
+    * <tt>target.putRecord(source, level, data, size)</tt> - instead of
+    * re-entering the target once per streamed value. Targets opt in by
+    * declaring <tt>static const bool wantsCompleteRecords = true</tt> in
+    * their TargetTraits specialization; the Logger then returns this sentry
+    * from operator<< instead of the classic LogSentry.
+    *
+    * \tparam Target The log target to hand the finished record to.
+    * \tparam outputEnabled Define whether this sentry outputs anything at all (see LogSentry).
+    * \tparam LoggerType The type of the logger that created this sentry.
+    */
+    template <
+        typename Target,
+        bool outputEnabled,
+        typename LoggerType
+        > class BufferedLogSentry
+    {
+        template <typename TargetType, bool trace, typename TargetTraits, unsigned char minCompiledLevel> friend class Logger;
+
+        /// the target snapshot, kept alive for the whole message (see LogSentry)
+        std::shared_ptr<Target> mTarget;
+        LoggerType const &mSource;
+        bool mEnabled;
+        unsigned char mLevel;
+        bool mIsTrace;
+        std::size_t mUsed;
+        char mSmall[256];
+        /// only used once the message outgrows mSmall. Arena-backed when the
+        /// target's traits declare wantsArenaBuffers, heap-backed otherwise.
+        typedef typename std::conditional<
+                detail::WantsArenaBuffers<typename LoggerType::TargetTraitsType>::value,
+                ArenaString, std::string>::type SpillType;
+        SpillType mSpill;
+
+        /**
+        * constructor for starting a log message with a trace level
+        */
+        BufferedLogSentry(std::shared_ptr<Target> target, LoggerType const &source, TraceLevel tl, bool enabled)
+            : mTarget(std::move(target)), mSource { source }, mEnabled { enabled }, mLevel(tl), mIsTrace(true), mUsed(0)
+        {
+        }
+
+        /**
+        * constructor for starting a log message with a log level
+        */
+        BufferedLogSentry(std::shared_ptr<Target> target, LoggerType const &source, LogLevel ll, bool enabled)
+            : mTarget(std::move(target)), mSource { source }, mEnabled { enabled }, mLevel(ll), mIsTrace(false), mUsed(0)
+        {
+        }
+
+        /// append raw characters to the captured record
+        void append(char const *data, std::size_t length)
+        {
+            if (mSpill.size() == 0 && mUsed+length <= sizeof(mSmall)) {
+                std::memcpy(mSmall+mUsed, data, length);
+                mUsed += length;
+            }
+            else {
+                if (mSpill.size() == 0) {
+                    mSpill.append(mSmall, mUsed);
+                    mUsed = 0;
+                }
+                mSpill.append(data, length);
+            }
+        }
+
+        /// cold continuation of the destructor for enabled messages
+        LOGGING_COLD void deliver()
+        {
+            char const *data = mSpill.size() > 0 ? mSpill.data() : mSmall;
+            std::size_t size = mSpill.size() > 0 ? mSpill.size() : mUsed;
+            if (mIsTrace) {
+                mTarget->putRecord(mSource, static_cast<TraceLevel>(mLevel), data, size);
+            }
+            else {
+                mTarget->putRecord(mSource, static_cast<LogLevel>(mLevel), data, size);
+            }
+            if (detail::WantsArenaBuffers<typename LoggerType::TargetTraitsType>::value) {
+                // the record has been handed over - every spill byte of this
+                // message comes back in one bump
+                threadArena().reset();
+            }
+        }
+
+    public:
+
+        BufferedLogSentry(BufferedLogSentry const &) = default;
+
+        /// hand the completed record to the target
+        ~BufferedLogSentry()
+        {
+            if (LOGGING_UNLIKELY(mEnabled)) {
+                deliver();
+            }
+        }
+
+        /// capture a signed integral value
+        template <typename ValueT>
+            inline typename std::enable_if<std::is_integral<ValueT>::value && std::is_signed<ValueT>::value,
+                                           BufferedLogSentry>::type &operator<<(ValueT const &v)
+        {
+            if (LOGGING_UNLIKELY(mEnabled)) {
+                char buf[24];
+                append(buf, std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v)));
+            }
+            return *this;
+        }
+
+        /// capture an unsigned integral value
+        template <typename ValueT>
+            inline typename std::enable_if<std::is_integral<ValueT>::value && std::is_unsigned<ValueT>::value,
+                                           BufferedLogSentry>::type &operator<<(ValueT const &v)
+        {
+            if (LOGGING_UNLIKELY(mEnabled)) {
+                char buf[24];
+                append(buf, std::snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(v)));
+            }
+            return *this;
+        }
+
+        /// capture a floating point value
+        template <typename ValueT>
+            inline typename std::enable_if<std::is_floating_point<ValueT>::value,
+                                           BufferedLogSentry>::type &operator<<(ValueT const &v)
+        {
+            if (LOGGING_UNLIKELY(mEnabled)) {
+                char buf[32];
+                append(buf, std::snprintf(buf, sizeof(buf), "%g", static_cast<double>(v)));
+            }
+            return *this;
+        }
+
+        /// capture a single character
+        inline BufferedLogSentry &operator<<(char v)
+        {
+            if (LOGGING_UNLIKELY(mEnabled)) {
+                append(&v, 1);
+            }
+            return *this;
+        }
+
+        /// capture a C string
+        inline BufferedLogSentry &operator<<(char const *v)
+        {
+            if (LOGGING_UNLIKELY(mEnabled)) {
+                append(v, std::strlen(v));
+            }
+            return *this;
+        }
+
+        /// capture a string
+        inline BufferedLogSentry &operator<<(std::string const &v)
+        {
+            if (LOGGING_UNLIKELY(mEnabled)) {
+                append(v.data(), v.size());
+            }
+            return *this;
+        }
+
+        /**
+        * capture any other value. Types without a direct conversion are
+        * formatted through a stringstream once.
+        */
+        template <typename ValueT>
+            inline typename std::enable_if<!std::is_arithmetic<ValueT>::value,
+                                           BufferedLogSentry>::type &operator<<(ValueT const &v)
+        {
+            if (LOGGING_UNLIKELY(mEnabled)) {
+                std::ostringstream os;
+                os << v;
+                append(os.str().data(), os.str().size());
+            }
+            return *this;
+        }
+
+        /**
+        * enable output like "<< std::endl" etc. The manipulator's character
+        * output is captured into the record; there is no stream to flush.
+        */
+        BufferedLogSentry &operator<<(std::basic_ostream<char>& (*manip)(std::basic_ostream<char>&))
+        {
+            if (LOGGING_UNLIKELY(mEnabled)) {
+                std::ostringstream os;
+                os << manip;
+                append(os.str().data(), os.str().size());
+            }
+            return *this;
+        }
+    };
+
+    /**
+    * Record-capturing sentry, disabled flavor.
+    * This class is just an empty shell to be optimized away.
+    */
+    template <
+        typename Target,
+        typename LoggerType
+        > class BufferedLogSentry<Target, false, LoggerType>
+    {
+        template <typename TargetType, bool trace, typename TargetTraits, unsigned char minCompiledLevel> friend class Logger;
+
+        BufferedLogSentry(std::shared_ptr<Target> const &, LoggerType const &, TraceLevel, bool)
+        {
+        }
+
+        BufferedLogSentry(std::shared_ptr<Target> const &, LoggerType const &, LogLevel, bool)
+        {
+        }
+
+    public:
+
+        /**
+         * output anything. This method is just an empty shell to be optimized away.
+         */
+        template <typename ValueT> inline BufferedLogSentry &operator<<(ValueT &&)
+        {
+            return *this;
+        }
+
+        /**
+        * enable output like "<< std::endl" etc.
+        */
+        BufferedLogSentry &operator<<(std::basic_ostream<char>& (*)(std::basic_ostream<char>&))
+        {
+            return *this;
+        }
+    };
+
     /**
     * generic traits type specifying some information about the
     * target.
     */
     template <typename TargetType> struct TargetTraits;
 
+    namespace detail
+    {
+        /**
+        * detect whether a traits type declares wantsCompleteRecords (and
+        * sets it to true). Targets use this flag to request the
+        * BufferedLogSentry, which hands them one contiguous record per
+        * message instead of individual put() calls. Traits without the
+        * member keep the classic streaming sentry.
+        */
+        template <typename Traits, typename = void> struct WantsCompleteRecords
+        {
+            static const bool value = false;
+        };
+
+        template <typename Traits> struct WantsCompleteRecords<Traits,
+                typename MakeVoid<decltype(Traits::wantsCompleteRecords)>::type>
+        {
+            static const bool value = Traits::wantsCompleteRecords;
+        };
+
+        /// append a signed integral value to the format buffer
+        template <typename ValueT>
+            typename std::enable_if<std::is_integral<ValueT>::value && std::is_signed<ValueT>::value>::type
+                appendFormatted(std::string &out, ValueT const &v)
+        {
+            char buf[24];
+            int len = std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v));
+            out.append(buf, len);
+        }
+
+        /// append an unsigned integral value to the format buffer
+        template <typename ValueT>
+            typename std::enable_if<std::is_integral<ValueT>::value && std::is_unsigned<ValueT>::value>::type
+                appendFormatted(std::string &out, ValueT const &v)
+        {
+            char buf[24];
+            int len = std::snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(v));
+            out.append(buf, len);
+        }
+
+        /// append a floating point value to the format buffer
+        template <typename ValueT>
+            typename std::enable_if<std::is_floating_point<ValueT>::value>::type
+                appendFormatted(std::string &out, ValueT const &v)
+        {
+            char buf[32];
+            int len = std::snprintf(buf, sizeof(buf), "%g", static_cast<double>(v));
+            out.append(buf, len);
+        }
+
+        /// append a single character to the format buffer
+        inline void appendFormatted(std::string &out, char const &v)
+        {
+            out += v;
+        }
+
+        /// append a C string to the format buffer
+        inline void appendFormatted(std::string &out, char const * const &v)
+        {
+            out += v;
+        }
+
+        /// append a string to the format buffer
+        inline void appendFormatted(std::string &out, std::string const &v)
+        {
+            out += v;
+        }
+
+        /// append any other value via iostream formatting
+        template <typename ValueT>
+            typename std::enable_if<!std::is_arithmetic<ValueT>::value>::type
+                appendFormatted(std::string &out, ValueT const &v)
+        {
+            std::ostringstream os;
+            os << v;
+            out += os.str();
+        }
+
+        /// render the remaining format string once the arguments are used up
+        inline void formatInto(std::string &out, char const *fmt)
+        {
+            while (*fmt) {
+                if (fmt[0] == '{' && fmt[1] == '{') {
+                    out += '{';
+                    fmt += 2;
+                }
+                else {
+                    out += *fmt++;
+                }
+            }
+        }
+
+        /**
+        * render the format string into the buffer, replacing each "{}"
+        * placeholder with the next argument. "{{" escapes a literal brace;
+        * surplus arguments are ignored, surplus placeholders are copied
+        * through verbatim.
+        */
+        template <typename Arg, typename... Rest>
+            void formatInto(std::string &out, char const *fmt, Arg const &arg, Rest const &...rest)
+        {
+            while (*fmt) {
+                if (fmt[0] == '{' && fmt[1] == '}') {
+                    appendFormatted(out, arg);
+                    formatInto(out, fmt+2, rest...);
+                    return;
+                }
+                if (fmt[0] == '{' && fmt[1] == '{') {
+                    out += '{';
+                    fmt += 2;
+                }
+                else {
+                    out += *fmt++;
+                }
+            }
+        }
+    }
+
+    /**
+    * Flat storage for the minimum levels of a whole logger tree. All loggers
+    * of one tree share a single table and keep a pointer to their slot, so
+    * the per-message level check is one relaxed atomic load and runtime level
+    * changes are plain atomic stores - safe against concurrent logging
+    * without any lock on the message path.
+    */
+    class LevelTable
+    {
+        // a deque never moves existing elements on growth, so the slot
+        // pointers handed out by allocate() stay valid for the lifetime of
+        // the table
+        std::deque<std::atomic<unsigned char>> mLevels;
+        std::mutex mMutex;  // only guards allocation, never the level reads
+        std::mutex mStructureMutex;
+
+    public:
+
+        /**
+        * the mutex guarding structural changes of the logger tree sharing
+        * this table: child creation and the tree walks of setTarget and
+        * setLevel take it, the per-message path never does.
+        *
+        * \return the tree's structural mutex
+        */
+        std::mutex &structureMutex()
+        {
+            return mStructureMutex;
+        }
+
+        /**
+        * allocate a level slot for a new logger.
+        *
+        * \param initial The initial level of the new slot.
+        * \return A pointer to the slot. Stays valid as long as the table lives.
+        */
+        std::atomic<unsigned char> *allocate(unsigned char initial)
+        {
+            std::lock_guard<std::mutex> guard(mMutex);
+            mLevels.emplace_back(initial);
+            return &mLevels.back();
+        }
+    };
+
     /**
     * Logger class
     *
@@ -225,18 +740,32 @@ namespace Logging {
     *              \endcode
     * \tparam TargetTraits The traits object defining some necessary information on the
     *              log target. Defaults to TargetTraits<Target>.
+    * \tparam minCompiledLevel The compile-time minimum level of this logger. Messages
+    *              with a level below this floor are compiled against the empty
+    *              LogSentry shell, the same mechanism the trace flag uses, and can
+    *              therefore be optimized out entirely - including the runtime level
+    *              comparison, when the level at the call site is a constant. The
+    *              default of LEVEL_TRACE compiles all levels in, preserving the
+    *              previous behavior.
     */
     template <
         typename Target,          // logging target
         bool trace,                   // tracing enabled?
-        typename TargetTraits = TargetTraits<Target>
+        typename TargetTraits = TargetTraits<Target>,
+        unsigned char minCompiledLevel = LEVEL_TRACE  // compile-time level floor
             > class Logger
     {
         std::string mName;
+        std::string mCanonicalName;
         std::shared_ptr<Target> mTarget;
         Logger *mParent;
-        std::map<std::string, std::shared_ptr<Logger>> mChildren;
-        unsigned char mLevel;
+        // children are kept in a flat vector searched linearly: loggers
+        // rarely have more than a handful of children, and the contiguous
+        // scan beats a std::map's tree walk both in cache behavior and in
+        // allocation count
+        std::vector<std::pair<std::string, std::shared_ptr<Logger>>> mChildren;
+        std::shared_ptr<LevelTable> mLevelTable;  // shared by the whole tree
+        std::atomic<unsigned char> *mLevel;       // this logger's slot in the table
 
         friend Target;
 
@@ -248,8 +777,70 @@ namespace Logging {
         * \param level the initial minimum message of this logger
         */
         Logger(std::string const &name, std::shared_ptr<Target> &t, Logger *parent, unsigned char level)
-            : mName(name), mTarget(t), mParent(parent), mLevel(level)
+            : mName(name), mTarget(t), mParent(parent), mLevelTable(parent->mLevelTable),
+              mLevel(mLevelTable->allocate(level))
+        {
+            // the parent chain never changes afterwards, so the full name can
+            // be computed once and for all here
+            if (parent->canonicalName().size() > 0) {
+                mCanonicalName = parent->canonicalName()+"::"+name;
+            }
+            else {
+                mCanonicalName = name;
+            }
+        }
+
+        /// recursive part of setLevel, runs under the structure mutex
+        void applyLevel(unsigned char level)
+        {
+            mLevel->store(level, std::memory_order_relaxed);
+            for (auto &i : mChildren) {
+                i.second->applyLevel(level);
+            }
+        }
+
+        /// recursive part of setTarget, runs under the structure mutex
+        void applyTarget(std::shared_ptr<Target> const &t)
         {
+            std::atomic_store_explicit(&mTarget, t, std::memory_order_release);
+            for (auto &child : mChildren) {
+                child.second->applyTarget(t);
+            }
+        }
+
+        /// parse a level name from the config format; 255 signals an unknown name
+        static unsigned char parseLevelName(char const *token, std::size_t length)
+        {
+            static char const * const names[6] = { "TRACE", "DEBUG", "INFO", "WARNING", "ERROR", "FATAL" };
+            for (unsigned char i = 0; i < 6; ++i) {
+                if (std::strlen(names[i]) == length && std::memcmp(names[i], token, length) == 0) {
+                    return i;
+                }
+            }
+            return 255;
+        }
+
+        /**
+        * find or create a child. Unlike child(), the lookup compares the
+        * characters in place and no structure mutex is taken - the
+        * bulk-construction path holds it already and resolves whole dotted
+        * paths without materializing a string per segment.
+        *
+        * \param name The child's name (not NUL-terminated).
+        * \param length The length of the name.
+        * \param childLevel The initial level if the child has to be created.
+        * \return the (possibly fresh) child
+        */
+        Logger *childUnlocked(char const *name, std::size_t length, unsigned char childLevel)
+        {
+            for (auto const &entry : mChildren) {
+                if (entry.first.size() == length && std::memcmp(entry.first.data(), name, length) == 0) {
+                    return entry.second.get();
+                }
+            }
+            std::string nameString(name, length);
+            mChildren.push_back(std::make_pair(nameString, std::shared_ptr<Logger>(new Logger(nameString, mTarget, this, childLevel))));
+            return mChildren.back().second.get();
         }
 
     public:
@@ -258,6 +849,15 @@ namespace Logging {
         typedef Target TargetType;
         /// the typedef exposing the traits to this target
         typedef TargetTraits TargetTraitsType;
+        /**
+        * the sentry type messages of this logger go through: the record
+        * capturing BufferedLogSentry if the target's traits ask for complete
+        * records, the classic streaming LogSentry otherwise
+        */
+        template <bool outputEnabled> using SentryType =
+            typename std::conditional<detail::WantsCompleteRecords<TargetTraits>::value,
+                                      BufferedLogSentry<Target, outputEnabled, Logger>,
+                                      LogSentry<Target, outputEnabled, Logger>>::type;
 
         /**
         * constructor for creating a root logger
@@ -266,7 +866,8 @@ namespace Logging {
         * \param name The name of the root logger (default: no name)
         */
         explicit Logger(std::shared_ptr<Target> const &t, std::string const &name = std::string())
-            : mName { name }, mTarget(t), mParent { nullptr }, mLevel { LEVEL_INFO }
+            : mName { name }, mCanonicalName { name }, mTarget(t), mParent { nullptr },
+              mLevelTable { new LevelTable() }, mLevel { mLevelTable->allocate(LEVEL_INFO) }
         {
         }
 
@@ -275,7 +876,8 @@ namespace Logging {
         * object with its standard constructor
         */
         Logger()
-            : mName { "" }, mTarget { new Target() }, mParent { nullptr }, mLevel { LEVEL_INFO }
+            : mName { "" }, mCanonicalName { "" }, mTarget { new Target() }, mParent { nullptr },
+              mLevelTable { new LevelTable() }, mLevel { mLevelTable->allocate(LEVEL_INFO) }
         {
         }
 
@@ -286,11 +888,19 @@ namespace Logging {
         * \return A LogSentry-object forwarding the rest of the message to the log target
         *          (depending on the message level)
         */
-        inline LogSentry<Target, true, Logger> operator<<(LogLevel ll)
+        inline SentryType<(minCompiledLevel <= LEVEL_FATAL)> operator<<(LogLevel ll)
         {
-            return LogSentry<Target,
-                            true,  // Log messages are always forwarded
-                            Logger>(*mTarget, *this, ll, ll >= mLevel);
+            // only an out-of-range floor removes log messages entirely. The
+            // target snapshot (an atomic shared_ptr load, which costs a lock
+            // from libstdc++'s internal pool plus refcount traffic) is taken
+            // only for messages that actually pass the level check - a
+            // disabled message stays a relaxed load and a branch, and the
+            // compile-time-elided shell never touches the target at all.
+            if ((ll >= minCompiledLevel) && LOGGING_UNLIKELY(ll >= mLevel->load(std::memory_order_relaxed))) {
+                return SentryType<(minCompiledLevel <= LEVEL_FATAL)>(
+                                std::atomic_load_explicit(&mTarget, std::memory_order_acquire), *this, ll, true);
+            }
+            return SentryType<(minCompiledLevel <= LEVEL_FATAL)>(std::shared_ptr<Target>(), *this, ll, false);
         }
 
         /**
@@ -301,11 +911,109 @@ namespace Logging {
         * \return A LogSentry-object forwarding the rest of the message to the log target
         *          (depending on the message level)
         */
-        inline LogSentry<Target, trace, Logger> operator<<(TraceLevel tl)
+        inline SentryType<trace && (minCompiledLevel <= LEVEL_DEBUG)> operator<<(TraceLevel tl)
         {
-            return LogSentry<Target,
-                            trace,  // trace output is decided in the sentry
-                            Logger>(*mTarget, *this, tl, tl >= mLevel);
+            // the target snapshot is only taken for messages that pass the
+            // level check (see the LogLevel overload); with tracing disabled
+            // the whole first branch is dead code
+            if (trace && (tl >= minCompiledLevel) && LOGGING_UNLIKELY(tl >= mLevel->load(std::memory_order_relaxed))) {
+                return SentryType<trace && (minCompiledLevel <= LEVEL_DEBUG)>(
+                                std::atomic_load_explicit(&mTarget, std::memory_order_acquire), *this, tl, true);
+            }
+            return SentryType<trace && (minCompiledLevel <= LEVEL_DEBUG)>(std::shared_ptr<Target>(), *this, tl, false);
+        }
+
+        /**
+        * Log a message with lazily evaluated content. The callable receives
+        * the message sentry and is only invoked when the message actually
+        * passes the level check, so any expensive values it builds cost
+        * nothing on suppressed messages - without a manual isEnabled() guard:
+        * \code
+        *     logger.log(Logging::LEVEL_DEBUG, [&](LoggerType::SentryType<true> &msg) {
+        *         msg << expensiveSummary(vec);
+        *     });
+        * \endcode
+        *
+        * \param ll The log level of this message.
+        * \param callable Invoked with the message sentry if the message is enabled.
+        */
+        template <typename Callable> inline void log(LogLevel ll, Callable const &callable)
+        {
+            if ((ll >= minCompiledLevel) && LOGGING_UNLIKELY(ll >= mLevel->load(std::memory_order_relaxed))) {
+                auto sentry = SentryType<(minCompiledLevel <= LEVEL_FATAL)>(
+                            std::atomic_load_explicit(&mTarget, std::memory_order_acquire), *this, ll, true);
+                callable(sentry);
+            }
+        }
+
+        /**
+        * Log a trace message with lazily evaluated content. With tracing
+        * disabled the level check is a compile-time constant false, so the
+        * call (and the callable invocation with it) is optimized away
+        * entirely, just like the empty LogSentry specialization.
+        *
+        * \param tl The trace level of this message.
+        * \param callable Invoked with the message sentry if the message is enabled.
+        */
+        template <typename Callable> inline void log(TraceLevel tl, Callable const &callable)
+        {
+            if (trace && (tl >= minCompiledLevel) && LOGGING_UNLIKELY(tl >= mLevel->load(std::memory_order_relaxed))) {
+                auto sentry = SentryType<trace && (minCompiledLevel <= LEVEL_DEBUG)>(
+                            std::atomic_load_explicit(&mTarget, std::memory_order_acquire), *this, tl, true);
+                callable(sentry);
+            }
+        }
+
+        /**
+        * Log a message assembled from a format string. Each "{}" placeholder
+        * is replaced by the corresponding argument ("{{" escapes a literal
+        * brace). The whole message is rendered into a per-thread buffer and
+        * handed to the target as a single put() call, instead of one target
+        * call per streamed value:
+        * \code
+        *     logger.logf(Logging::LEVEL_INFO, "request {} took {}ms", id, millis);
+        * \endcode
+        * Nothing is rendered when the message does not pass the level check.
+        *
+        * \param ll The log level of this message.
+        * \param fmt The format string.
+        * \param args The values replacing the "{}" placeholders, in order.
+        * \note The assembled message is a narrow string; use the streaming
+        *       interface for targets with a non-char char_type.
+        */
+        template <typename... Args> void logf(LogLevel ll, char const *fmt, Args const &...args)
+        {
+            if ((ll >= minCompiledLevel) && LOGGING_UNLIKELY(ll >= mLevel->load(std::memory_order_relaxed))) {
+                static thread_local std::string buffer;
+                buffer.clear();
+                detail::formatInto(buffer, fmt, args...);
+                auto target = std::atomic_load_explicit(&mTarget, std::memory_order_acquire);
+                target->startMessage(*this, ll);
+                target->put(*this, buffer);
+                target->endMessage(*this);
+            }
+        }
+
+        /**
+        * Log a trace message assembled from a format string. See the
+        * LogLevel overload for the placeholder syntax. With tracing disabled
+        * the whole call is optimized away.
+        *
+        * \param tl The trace level of this message.
+        * \param fmt The format string.
+        * \param args The values replacing the "{}" placeholders, in order.
+        */
+        template <typename... Args> void logf(TraceLevel tl, char const *fmt, Args const &...args)
+        {
+            if (trace && (tl >= minCompiledLevel) && LOGGING_UNLIKELY(tl >= mLevel->load(std::memory_order_relaxed))) {
+                static thread_local std::string buffer;
+                buffer.clear();
+                detail::formatInto(buffer, fmt, args...);
+                auto target = std::atomic_load_explicit(&mTarget, std::memory_order_acquire);
+                target->startMessage(*this, tl);
+                target->put(*this, buffer);
+                target->endMessage(*this);
+            }
         }
 
         /**
@@ -318,6 +1026,19 @@ namespace Logging {
             return mName;
         }
 
+        /**
+        * Get the full name of this logger. The canonical name consists of the
+        * full chain of names up to the root logger separated by "::". It is
+        * computed once at construction, so this accessor is cheap enough for
+        * use on the per-message path.
+        *
+        * \return The full canonical name of this logger.
+        */
+        inline std::string const &canonicalName() const
+        {
+            return mCanonicalName;
+        }
+
         /**
         * Return the parent logger of this object (if any).
         *
@@ -332,17 +1053,16 @@ namespace Logging {
         /**
         * Set the minimum log level of this object. Messages have to at least have this
         * level to be forwarded to the log target. This call will <em>also set the levels
-        * of all child-loggers!</em>
+        * of all child-loggers!</em> The levels live in atomic slots, so changing them is
+        * safe while other threads are concurrently logging.
         *
         * \param level The log level to set must be one of the values from TraceLevel or
         *              LogLevel.
         */
         void setLevel(unsigned char level)
         {
-            mLevel = level;
-            for (auto i : mChildren) {
-                i.second->setLevel(level);
-            }
+            std::lock_guard<std::mutex> guard(mLevelTable->structureMutex());
+            applyLevel(level);
         }
 
         /**
@@ -352,7 +1072,7 @@ namespace Logging {
          */
         unsigned char level() const
         {
-            return mLevel;
+            return mLevel->load(std::memory_order_relaxed);
         }
 
         /**
@@ -368,7 +1088,7 @@ namespace Logging {
          */
         bool isEnabled(LogLevel level) const
         {
-            return level >= mLevel;
+            return (level >= minCompiledLevel) && (level >= mLevel->load(std::memory_order_relaxed));
         }
 
         /**
@@ -381,7 +1101,7 @@ namespace Logging {
          */
         bool isEnabled(TraceLevel level) const
         {
-            return (level >= mLevel) && trace;
+            return (level >= minCompiledLevel) && (level >= mLevel->load(std::memory_order_relaxed)) && trace;
         }
 
         /**
@@ -401,32 +1121,154 @@ namespace Logging {
             if (name.size() == 0) {
                 throw std::invalid_argument("name must not be empty");
             }
-            auto child = mChildren.find(name);
-            if (child == mChildren.end()) {
-                child = mChildren.insert(std::make_pair(name, std::shared_ptr<Logger>(new Logger(name, mTarget, this, mLevel)))).first;
+            std::lock_guard<std::mutex> guard(mLevelTable->structureMutex());
+            for (auto const &entry : mChildren) {
+                if (entry.first == name) {
+                    return entry.second;
+                }
+            }
+            mChildren.push_back(std::make_pair(name, std::shared_ptr<Logger>(new Logger(name, mTarget, this, level()))));
+            return mChildren.back().second;
+        }
+
+        /**
+        * Get a child logger of the current logger by a C string name. Same
+        * semantics as child(std::string const&), but the lookup compares the
+        * characters in place - a std::string is only materialized when the
+        * child does not exist yet. Use this overload with literal names on
+        * hot paths.
+        *
+        * \param name The name of this sub-logger. The name cannot be empty.
+        * \return A logger object with the given name and the same configuration as the
+        *          parent logger.
+        */
+        std::shared_ptr<Logger> child(char const *name)
+        {
+            if (name == nullptr || name[0] == '\0') {
+                throw std::invalid_argument("name must not be empty");
+            }
+            std::lock_guard<std::mutex> guard(mLevelTable->structureMutex());
+            for (auto const &entry : mChildren) {
+                if (entry.first == name) {
+                    return entry.second;
+                }
+            }
+            std::string nameString(name);
+            mChildren.push_back(std::make_pair(nameString, std::shared_ptr<Logger>(new Logger(nameString, mTarget, this, level()))));
+            return mChildren.back().second;
+        }
+
+        /**
+        * Bulk-construct a logger subtree from a compact config. The config
+        * is one entry per line in the form <tt>path=LEVEL</tt>, where path
+        * is a "::"-separated chain of child names below this logger (empty
+        * for this logger itself) and LEVEL is one of TRACE, DEBUG, INFO,
+        * WARNING, ERROR or FATAL. Blank lines and lines starting with '#'
+        * are skipped:
+        * \code
+        *     root.configure("db=WARNING\n"
+        *                    "db::pool=ERROR\n"
+        *                    "# noisy during rollout\n"
+        *                    "net::http=DEBUG\n");
+        * \endcode
+        *
+        * The whole tree is built in one pass under a single acquisition of
+        * the structure mutex: every missing logger on a path is created with
+        * its level set right at construction, and the path segments are
+        * resolved in place without the per-segment string splitting and
+        * repeated child() locking of a hand-written startup loop. A line
+        * sets exactly the named logger (creation still inherits as usual);
+        * it does not recurse into existing children - use setLevel for that.
+        * Later calls may extend or adjust the tree; loggers are never
+        * removed.
+        *
+        * \param config The configuration text.
+        * \throw std::invalid_argument on a malformed line or unknown level name.
+        */
+        void configure(char const *config)
+        {
+            std::lock_guard<std::mutex> guard(mLevelTable->structureMutex());
+            char const *p = config;
+            while (*p) {
+                char const *lineEnd = p;
+                while (*lineEnd && *lineEnd != '\n') {
+                    ++lineEnd;
+                }
+                char const *s = p;
+                char const *e = lineEnd;
+                p = *lineEnd ? lineEnd+1 : lineEnd;
+                while (s < e && (*s == ' ' || *s == '\t')) {
+                    ++s;
+                }
+                while (e > s && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r')) {
+                    --e;
+                }
+                if (s == e || *s == '#') {
+                    continue;
+                }
+                char const *eq = s;
+                while (eq < e && *eq != '=') {
+                    ++eq;
+                }
+                if (eq == e) {
+                    throw std::invalid_argument("config line without '='");
+                }
+                char const *pathEnd = eq;
+                while (pathEnd > s && (pathEnd[-1] == ' ' || pathEnd[-1] == '\t')) {
+                    --pathEnd;
+                }
+                char const *levelToken = eq+1;
+                while (levelToken < e && (*levelToken == ' ' || *levelToken == '\t')) {
+                    ++levelToken;
+                }
+                unsigned char configuredLevel = parseLevelName(levelToken, e-levelToken);
+                if (configuredLevel == 255) {
+                    throw std::invalid_argument("unknown level name in config");
+                }
+                Logger *node = this;
+                char const *segment = s;
+                while (segment < pathEnd) {
+                    char const *segmentEnd = segment;
+                    while (segmentEnd < pathEnd && *segmentEnd != ':') {
+                        ++segmentEnd;
+                    }
+                    bool last = (segmentEnd == pathEnd);
+                    if (!last && (segmentEnd+1 >= pathEnd || segmentEnd[1] != ':')) {
+                        throw std::invalid_argument("malformed path separator in config");
+                    }
+                    if (segmentEnd == segment) {
+                        throw std::invalid_argument("empty path segment in config");
+                    }
+                    node = node->childUnlocked(segment, segmentEnd-segment,
+                                               last ? configuredLevel : node->level());
+                    segment = last ? pathEnd : segmentEnd+2;
+                }
+                node->mLevel->store(configuredLevel, std::memory_order_relaxed);
             }
-            return child->second;
         }
 
         /**
          * get the target currently associated with this Logger
          *
-         * \return a shared_ptr to the target object associated with this logger
+         * \return a snapshot of the target object associated with this logger
          */
-        std::shared_ptr<Target> const &target() const
+        std::shared_ptr<Target> target() const
         {
-            return mTarget;
+            return std::atomic_load_explicit(&mTarget, std::memory_order_acquire);
         }
 
         /**
-         * set the target object associated with this logger <em>and all its children</em>
+         * set the target object associated with this logger <em>and all its
+         * children</em>. Safe to call while other threads are logging: each
+         * logger publishes the new target with an atomic shared_ptr store,
+         * messages already in flight finish against the snapshot their
+         * sentry took, and the tree walk itself is serialized against
+         * concurrent child() calls by the tree's structure mutex.
          */
         void setTarget(std::shared_ptr<Target> const &t)
         {
-            mTarget = t;
-            for (auto &child : mChildren) {
-                child.second->setTarget(t);
-            }
+            std::lock_guard<std::mutex> guard(mLevelTable->structureMutex());
+            applyTarget(t);
         }
     };
 
@@ -437,8 +1279,8 @@ namespace Logging {
     *         empty log messages being output, your compiler might be creating and destroying real objects here.
     *         Throw it away then.
     */
-    template <typename Target, bool trace, typename TargetTraitsType> inline auto
-            operator<<(std::shared_ptr<Logger<Target, trace, TargetTraitsType>> const &l, TraceLevel tl)
+    template <typename Target, bool trace, typename TargetTraitsType, unsigned char minCompiledLevel> inline auto
+            operator<<(std::shared_ptr<Logger<Target, trace, TargetTraitsType, minCompiledLevel>> const &l, TraceLevel tl)
                 -> decltype(*l.get() << tl)
     {
         // using .get() here instead of the normal dereference, as this is an unchecked operation and can be optimized out
@@ -452,8 +1294,8 @@ namespace Logging {
     *         empty log messages being output, your compiler might be creating and destroying real objects here.
     *         Throw it away then.
     */
-    template <typename Target, bool trace, typename TargetTraitsType> inline auto
-            operator<<(std::shared_ptr<Logger<Target, trace, TargetTraitsType>> const &l, LogLevel ll)
+    template <typename Target, bool trace, typename TargetTraitsType, unsigned char minCompiledLevel> inline auto
+            operator<<(std::shared_ptr<Logger<Target, trace, TargetTraitsType, minCompiledLevel>> const &l, LogLevel ll)
                 -> decltype((*l) << ll)
     {
         return (*l) << ll;
@@ -0,0 +1,130 @@
+#ifndef LOGRECORD_HXX
+#define LOGRECORD_HXX
+
+/*
+Copyright (c) 2014, Markus Brueckner <namenlos@geekbetrieb.de>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither my name nor the names of any contributors may be used to endorse
+      or promote products derived from this software without specific prior
+      written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL I, THE AUTHOR OF THIS SOFTWARE, BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string>
+
+#include "logging.hxx"
+
+namespace Logging
+{
+    /**
+    * A fully captured log message. Deferring targets (e.g. AsyncTarget) detach
+    * the message from the logger that created it by capturing everything a
+    * downstream target needs into one of these records: the canonical logger
+    * name, the already formatted message text and the level. The record can
+    * later be replayed into any target implementing the usual
+    * startMessage/put/endMessage protocol.
+    */
+    struct LogRecord
+    {
+        /// the full canonical name of the logger the message originated from
+        std::string loggerName;
+        /// the formatted message body
+        std::string text;
+        /// the numeric level of the message (one of TraceLevel or LogLevel)
+        unsigned char level;
+        /// true, if level holds a TraceLevel, false for a LogLevel
+        bool isTrace;
+    };
+
+    /**
+    * Stand-in for the originating logger when a LogRecord is replayed.
+    * Targets only ever use the name()/parent() pair of their source argument
+    * (via canonicalName()), so this small object is sufficient to make a
+    * detached record look like a live logger to any downstream target.
+    */
+    class RecordSource
+    {
+        std::string const &mName;
+
+    public:
+
+        /**
+        * \param name The canonical name captured in the record.
+        */
+        explicit RecordSource(std::string const &name)
+            : mName(name)
+        {
+        }
+
+        /**
+        * Targets consult the Logger's traits for capability flags when they
+        * build the message prefix. A replayed record no longer knows the
+        * Logger typedef it came from, so it reports plain default traits -
+        * all flags on.
+        */
+        struct TargetTraitsType
+        {
+            typedef char char_type;
+            typedef std::char_traits<char> char_traits_type;
+        };
+
+        /// the captured canonical name of the original logger
+        std::string const &name() const
+        {
+            return mName;
+        }
+
+        /// same as name() - the captured name is already the canonical one
+        std::string const &canonicalName() const
+        {
+            return mName;
+        }
+
+        /// records are always replayed as if they came from a root logger
+        RecordSource *parent() const
+        {
+            return nullptr;
+        }
+    };
+
+    /**
+    * Replay a captured record into a downstream target. The record is
+    * delivered as a single put() of the preformatted message body, framed
+    * by the usual startMessage/endMessage pair.
+    *
+    * \param target The target to deliver the record to.
+    * \param record The record to replay.
+    */
+    template <typename Target> void deliverRecord(Target &target, LogRecord const &record)
+    {
+        RecordSource source(record.loggerName);
+        if (record.isTrace) {
+            target.startMessage(source, static_cast<TraceLevel>(record.level));
+        }
+        else {
+            target.startMessage(source, static_cast<LogLevel>(record.level));
+        }
+        target.put(source, record.text);
+        target.endMessage(source);
+    }
+}
+
+#endif // LOGRECORD_HXX
@@ -0,0 +1,320 @@
+#ifndef MMAPFILETARGET_HXX
+#define MMAPFILETARGET_HXX
+
+/*
+Copyright (c) 2014, Markus Brueckner <namenlos@geekbetrieb.de>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither my name nor the names of any contributors may be used to endorse
+      or promote products derived from this software without specific prior
+      written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL I, THE AUTHOR OF THIS SOFTWARE, BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "logging.hxx"
+#include "logging_utils.hxx"
+#include "locking.hxx"
+
+namespace Logging
+{
+    /**
+    * Logging target appending formatted messages directly into a memory
+    * mapped log file. The file is preallocated and extended in large chunks,
+    * so the per-message hot path is a memcpy into the mapping plus a cursor
+    * bump - no write() syscall at all. A small header at the start of the
+    * file records the number of valid payload bytes; it is updated after the
+    * message bytes are in place, so after a crash the file is readable up to
+    * the last completely written message (trailing preallocated zero bytes
+    * can be ignored by checking the header).
+    *
+    * \tparam LockType The type of Lock adapter to use. See OStreamTarget for the requirements.
+    */
+    template <typename LockType = NullLock> class MmapFileTarget : public LockType
+    {
+        /// on-disk header at offset 0 of the mapped file
+        struct FileHeader
+        {
+            char magic[8];
+            std::uint64_t validLength;  // number of valid payload bytes after the header
+        };
+
+        static constexpr char const *MAGIC = "MMAPLOG1";
+
+        int mFd;
+        std::size_t mChunkSize;
+        std::size_t mMappedSize;   // current size of file and mapping, including the header
+        char *mMap;
+        std::uint64_t mCursor;     // absolute file offset of the next free byte
+        std::string mBuffer;
+
+        FileHeader *header()
+        {
+            return reinterpret_cast<FileHeader *>(mMap);
+        }
+
+        /// grow file and mapping so that at least `needed` more bytes fit
+        void ensureRoom(std::size_t needed)
+        {
+            if (mCursor+needed <= mMappedSize) {
+                return;
+            }
+            std::size_t newSize = mMappedSize;
+            while (mCursor+needed > newSize) {
+                newSize += mChunkSize;
+            }
+            preallocate(newSize);
+            remap(newSize);
+        }
+
+        /// reserve disk space for the file up to the given size
+        void preallocate(std::size_t size)
+        {
+            if (::posix_fallocate(mFd, 0, size) != 0) {
+                // e.g. filesystem without fallocate support - fall back to
+                // plain truncation (creates a sparse file)
+                if (::ftruncate(mFd, size) != 0) {
+                    throw std::runtime_error("could not grow memory mapped log file");
+                }
+            }
+        }
+
+        /**
+        * establish a mapping of the given size, replacing the current one
+        * (if any). The new mapping is created before the old one is given
+        * up: if growing fails (address space exhausted, disk full), mMap
+        * and mMappedSize still describe the valid old mapping and the
+        * destructor releases it exactly once.
+        */
+        void remap(std::size_t size)
+        {
+            void *map = ::mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED, mFd, 0);
+            if (map == MAP_FAILED) {
+                throw std::runtime_error("could not map log file");
+            }
+            if (mMap) {
+                ::munmap(mMap, mMappedSize);
+            }
+            mMap = static_cast<char *>(map);
+            mMappedSize = size;
+        }
+
+        /// write the common "(name) [LEVEL] " prefix into the assembly buffer
+        template <typename LoggerType> void startPrefix(LoggerType const &source, char const *level)
+        {
+            std::string const &logName = source.canonicalName();
+            if (logName.size() > 0) {
+                mBuffer += '(';
+                mBuffer += logName;
+                mBuffer += ") ";
+            }
+            mBuffer += '[';
+            mBuffer += level;
+            mBuffer += "] ";
+        }
+
+    public:
+
+        /**
+        * Constructor.
+        *
+        * \param fileName The log file to append to. Created if necessary; an
+        *                 existing file written by this target is continued
+        *                 at its recorded valid length.
+        * \param chunkSize The granularity (in bytes) the file is preallocated
+        *                  and extended with. Default: 16 MiB.
+        */
+        explicit MmapFileTarget(char const *fileName, std::size_t chunkSize = 16*1024*1024)
+            : mFd(::open(fileName, O_RDWR|O_CREAT, 0644)), mChunkSize(chunkSize),
+              mMappedSize(0), mMap(nullptr), mCursor(sizeof(FileHeader))
+        {
+            if (mFd < 0) {
+                throw std::runtime_error(std::string("could not open log file ")+fileName);
+            }
+            FileHeader existing;
+            bool resume = ::read(mFd, &existing, sizeof(existing)) == sizeof(existing)
+                          && std::memcmp(existing.magic, MAGIC, sizeof(existing.magic)) == 0;
+            preallocate(sizeof(FileHeader)+mChunkSize);
+            remap(sizeof(FileHeader)+mChunkSize);
+            if (resume) {
+                mCursor = sizeof(FileHeader)+existing.validLength;
+                ensureRoom(0);
+            }
+            else {
+                std::memcpy(header()->magic, MAGIC, sizeof(header()->magic));
+                header()->validLength = 0;
+            }
+        }
+
+        MmapFileTarget(MmapFileTarget const &) = delete;
+        MmapFileTarget &operator=(MmapFileTarget const &) = delete;
+
+        ~MmapFileTarget()
+        {
+            if (mMap) {
+                ::munmap(mMap, mMappedSize);
+            }
+            if (mFd >= 0) {
+                // give the unused preallocated tail back to the filesystem
+                auto truncated = ::ftruncate(mFd, mCursor);
+                (void)truncated;
+                ::close(mFd);
+            }
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param tl the level of this message
+        * \note This method calls LockType::lock(). It might therefore block until the lock is available.
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, TraceLevel tl)
+        {
+            LockType::lock();
+            startPrefix(source, levelName(tl));
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param ll the level of this message
+        * \note This method calls LockType::lock(). It might therefore block until the lock is available.
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, LogLevel ll)
+        {
+            LockType::lock();
+            startPrefix(source, levelName(ll));
+        }
+
+        /**
+        * finish a message from the given source. The assembled line is
+        * copied into the mapping and the valid length in the header is
+        * published afterwards, keeping the file consistent across crashes.
+        */
+        template <typename LoggerType> void endMessage(LoggerType const &)
+        {
+            mBuffer += '\n';
+            ensureRoom(mBuffer.size());
+            std::memcpy(mMap+mCursor, mBuffer.data(), mBuffer.size());
+            mCursor += mBuffer.size();
+            // make sure the message bytes are in place before the length
+            // that declares them valid becomes visible
+            std::atomic_thread_fence(std::memory_order_release);
+            header()->validLength = mCursor-sizeof(FileHeader);
+            mBuffer.clear();
+            LockType::unlock();
+        }
+
+        /// output a signed integral value to the assembly buffer
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<std::is_integral<ValueT>::value && std::is_signed<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            char buf[24];
+            int len = std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v));
+            mBuffer.append(buf, len);
+        }
+
+        /// output an unsigned integral value to the assembly buffer
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<std::is_integral<ValueT>::value && std::is_unsigned<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            char buf[24];
+            int len = std::snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(v));
+            mBuffer.append(buf, len);
+        }
+
+        /// output a floating point value to the assembly buffer
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<std::is_floating_point<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            char buf[32];
+            int len = std::snprintf(buf, sizeof(buf), "%g", static_cast<double>(v));
+            mBuffer.append(buf, len);
+        }
+
+        /// output a single character to the assembly buffer
+        template <typename LoggerType> void put(LoggerType const &, char const &v)
+        {
+            mBuffer += v;
+        }
+
+        /// output a C string to the assembly buffer
+        template <typename LoggerType> void put(LoggerType const &, char const * const &v)
+        {
+            mBuffer += v;
+        }
+
+        /// output a string to the assembly buffer
+        template <typename LoggerType> void put(LoggerType const &, std::string const &v)
+        {
+            mBuffer += v;
+        }
+
+        /// output any other value via iostream formatting
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<!std::is_arithmetic<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            std::ostringstream os;
+            os << v;
+            mBuffer += os.str();
+        }
+
+        /**
+        * Output stuff like std::endl to the buffer. std::endl degrades to a
+        * plain newline here; there is nothing to flush.
+        *
+        * \param manip The manipulator to output.
+        */
+        void put(std::basic_ostream<char>& (*manip)(std::basic_ostream<char>&))
+        {
+            std::ostringstream os;
+            os << manip;
+            mBuffer += os.str();
+        }
+    };
+
+    /**
+     * traits specialization for the MmapFileTarget
+     */
+    template <typename LockType> struct TargetTraits<MmapFileTarget<LockType>>
+    {
+        typedef char char_type;
+        typedef std::char_traits<char> char_traits_type;
+    };
+}
+#endif // MMAPFILETARGET_HXX
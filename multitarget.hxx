@@ -28,176 +28,169 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <array>
 #include <iostream>
 #include <stdexcept>
+#include <tuple>
 #include "logging.hxx"
 
-namespace Logging 
+namespace Logging
 {
+    /**
+    * internal helpers for building the compile-time dispatch tables of
+    * MultiTarget (a minimal stand-in for the integer sequences C++14 brings)
+    */
+    namespace detail
+    {
+        template <unsigned int... Is> struct IndexSequence {};
+
+        template <unsigned int N, unsigned int... Is> struct MakeIndexSequence
+            : MakeIndexSequence<N-1, N-1, Is...>
+        {
+        };
+
+        template <unsigned int... Is> struct MakeIndexSequence<0, Is...>
+        {
+            typedef IndexSequence<Is...> type;
+        };
+    }
+
     /**
     * Pseudo-target wrapping two or more other targets to support
     * target switching.
-    * 
+    *
+    * Every operation is dispatched to the active target through a jump table
+    * built at compile time over the SubTargets pack, so a call is a single
+    * indexed indirect call regardless of how many targets are configured and
+    * which one is active - the previous implementation walked an if-chain of
+    * index comparisons for every startMessage/put/endMessage.
+    *
     * TODO explain in detail the use, esp. the fact, that SubTargets has to be a list of std::shared_ptr
     */
     template <typename... SubTargets> class MultiTarget
     {
         unsigned int mActiveTarget;
-        
-        /**
-        * internal class implementing the target dispatch
-        */
-        template <unsigned int targetIndex, typename Target, typename... Remaining> class TargetHolder
-            : public TargetHolder<targetIndex+1, Remaining...>
-        {
-            Target mTarget;
-        public:
-            
-            TargetHolder(Target const &target, Remaining... remaining)
-                : TargetHolder<targetIndex+1, Remaining...>(remaining...), mTarget(target)
-            {
-            }
-            
-            template <typename LoggerT> void startMessage(unsigned int index, LoggerT const &source, TraceLevel tl)
-            {
-                if (index == targetIndex) {
-                    mTarget->startMessage(source, tl);
-                }
-                else {
-                    TargetHolder<targetIndex+1, Remaining...>::startMessage(index, source, tl);
-                }
-            }
+        std::tuple<SubTargets...> mTargets;
 
-            template <typename LoggerT> void startMessage(unsigned int index, LoggerT const &source, LogLevel ll)
-            {
-                if (index == targetIndex) {
-                    mTarget->startMessage(source, ll);
-                }
-                else {
-                    TargetHolder<targetIndex+1, Remaining...>::startMessage(index, source, ll);
-                }
-            }            
-            
-            template <typename LoggerT> void endMessage(unsigned int index, LoggerT const &source)
-            {
-                if (index == targetIndex) {
-                    mTarget->endMessage(source);
-                }
-                else {
-                    TargetHolder<targetIndex+1, Remaining...>::endMessage(index, source);
-                }
-            }
-            
-            template <typename LoggerT, typename ValueT> void put(unsigned int index, LoggerT const &source, ValueT const &v)
-            {
-                if (index == targetIndex) {
-                    mTarget->put(source, v);
-                }
-                else {
-                    TargetHolder<targetIndex+1, Remaining...>::put(index, source, v);
-                }
-            }
+        typedef typename detail::MakeIndexSequence<sizeof...(SubTargets)>::type Indices;
 
-            void put(unsigned int index, std::basic_ostream<char>& (*manip)(std::basic_ostream<char>&))
-            {
-                if (index == targetIndex) {
-                    mTarget->put(manip);
-                }
-                else {
-                    TargetHolder<targetIndex+1, Remaining...>::put(index, manip);
-                }
-            }
-        };
-        
-        /**
-         * Specialization stopping the recursive instantiation of the TargetHolder template
-         */
-        template <unsigned int targetIndex, typename Target> class TargetHolder<targetIndex, Target>
-        {
-            Target mTarget;
-            
-        public:
-            
-            TargetHolder(Target const &target)
-                : mTarget(target)
-            {
-            }
-            
-            template <typename LoggerT> void startMessage(unsigned int, LoggerT const &source, TraceLevel tl)
-            {
-                mTarget->startMessage(source, tl);
-            }
+        // the per-operation trampolines the jump tables point to. Each one is
+        // instantiated once per target index and forwards to that target.
 
-            template <typename LoggerT> void startMessage(unsigned int, LoggerT const &source, LogLevel ll)
-            {
-                mTarget->startMessage(source, ll);
-            }
-            
-            template <typename LoggerT> void endMessage(unsigned int, LoggerT const &source)
-            {
-                mTarget->endMessage(source);
-            }
+        template <typename LoggerT, unsigned int I>
+            static void startTraceImpl(MultiTarget &self, LoggerT const &source, TraceLevel tl)
+        {
+            std::get<I>(self.mTargets)->startMessage(source, tl);
+        }
 
-            template <typename LoggerT, typename ValueT> void put(unsigned int, LoggerT const &source, ValueT const &v)
-            {
-                mTarget->put(source, v);
-            }
+        template <typename LoggerT, unsigned int I>
+            static void startLogImpl(MultiTarget &self, LoggerT const &source, LogLevel ll)
+        {
+            std::get<I>(self.mTargets)->startMessage(source, ll);
+        }
+
+        template <typename LoggerT, unsigned int I>
+            static void endImpl(MultiTarget &self, LoggerT const &source)
+        {
+            std::get<I>(self.mTargets)->endMessage(source);
+        }
+
+        template <typename LoggerT, typename ValueT, unsigned int I>
+            static void putImpl(MultiTarget &self, LoggerT const &source, ValueT const &v)
+        {
+            std::get<I>(self.mTargets)->put(source, v);
+        }
+
+        template <unsigned int I>
+            static void putManipImpl(MultiTarget &self, std::basic_ostream<char>& (*manip)(std::basic_ostream<char>&))
+        {
+            std::get<I>(self.mTargets)->put(manip);
+        }
+
+        // table builders expanding the trampolines over the index pack
+
+        template <typename LoggerT, unsigned int... Is>
+            static std::array<void (*)(MultiTarget &, LoggerT const &, TraceLevel), sizeof...(SubTargets)>
+                makeStartTraceTable(detail::IndexSequence<Is...>)
+        {
+            return {{ &startTraceImpl<LoggerT, Is>... }};
+        }
+
+        template <typename LoggerT, unsigned int... Is>
+            static std::array<void (*)(MultiTarget &, LoggerT const &, LogLevel), sizeof...(SubTargets)>
+                makeStartLogTable(detail::IndexSequence<Is...>)
+        {
+            return {{ &startLogImpl<LoggerT, Is>... }};
+        }
+
+        template <typename LoggerT, unsigned int... Is>
+            static std::array<void (*)(MultiTarget &, LoggerT const &), sizeof...(SubTargets)>
+                makeEndTable(detail::IndexSequence<Is...>)
+        {
+            return {{ &endImpl<LoggerT, Is>... }};
+        }
+
+        template <typename LoggerT, typename ValueT, unsigned int... Is>
+            static std::array<void (*)(MultiTarget &, LoggerT const &, ValueT const &), sizeof...(SubTargets)>
+                makePutTable(detail::IndexSequence<Is...>)
+        {
+            return {{ &putImpl<LoggerT, ValueT, Is>... }};
+        }
+
+        template <unsigned int... Is>
+            static std::array<void (*)(MultiTarget &, std::basic_ostream<char>& (*)(std::basic_ostream<char>&)), sizeof...(SubTargets)>
+                makePutManipTable(detail::IndexSequence<Is...>)
+        {
+            return {{ &putManipImpl<Is>... }};
+        }
 
-            void put(unsigned int, std::basic_ostream<char>& (*manip)(std::basic_ostream<char>&))
-            {
-                mTarget->put(manip);
-            }
-            
-            inline unsigned int maxIndex() const
-            {
-                return targetIndex;
-            }
-        };
-        
-        TargetHolder<0, SubTargets...> mSubtargets;
-        
     public:
-        
+
         MultiTarget(SubTargets... targets)
-            : mActiveTarget(0), mSubtargets(targets...)
+            : mActiveTarget(0), mTargets(targets...)
         {
         }
-        
+
         template <typename LoggerType> void startMessage(LoggerType const &source, TraceLevel tl)
         {
-            mSubtargets.startMessage(mActiveTarget, source, tl);
+            static auto const table = makeStartTraceTable<LoggerType>(Indices());
+            table[mActiveTarget](*this, source, tl);
         }
 
         template <typename LoggerType> void startMessage(LoggerType const &source, LogLevel ll)
         {
-            mSubtargets.startMessage(mActiveTarget, source, ll);
+            static auto const table = makeStartLogTable<LoggerType>(Indices());
+            table[mActiveTarget](*this, source, ll);
         }
-        
+
         template <typename LoggerType> void endMessage(LoggerType const &source)
         {
-            mSubtargets.endMessage(mActiveTarget, source);
+            static auto const table = makeEndTable<LoggerType>(Indices());
+            table[mActiveTarget](*this, source);
         }
 
         template <typename LoggerType, typename ValueType> void put(LoggerType const &source, ValueType const &v)
         {
-            mSubtargets.put(mActiveTarget, source, v);
+            static auto const table = makePutTable<LoggerType, ValueType>(Indices());
+            table[mActiveTarget](*this, source, v);
         }
-        
+
         /**
         * Output stuff like std::endl to the underlying stream.
-        * 
+        *
         * \param manip The manipulator to output to the underlying stream.
         */
         void put(std::basic_ostream<char>& (*manip)(std::basic_ostream<char>&))
         {
-            mSubtargets.put(mActiveTarget, manip);
+            static auto const table = makePutManipTable(Indices());
+            table[mActiveTarget](*this, manip);
         }
-        
+
         void setActive(unsigned int index)
         {
-            if (index > mSubtargets.maxIndex()) {
+            if (index >= sizeof...(SubTargets)) {
                 throw std::runtime_error(std::string("Could not active target with index ")+std::to_string(index)+
-                                        ". Maximum is "+std::to_string(mSubtargets.maxIndex()));
+                                        ". Maximum is "+std::to_string(sizeof...(SubTargets)-1));
             }
             mActiveTarget = index;
         }
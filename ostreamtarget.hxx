@@ -29,13 +29,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <ostream>
+#include <sstream>
 #include <chrono>
 #include <ctime>
 #include <string>
+#include <type_traits>
 
 #include "logging.hxx"
 #include "locking.hxx"
 #include "logging_utils.hxx"
+#include "flushscheduler.hxx"
 
 namespace Logging
 {
@@ -56,6 +59,14 @@ namespace Logging
     *                                      again.
     *                 Due to the interface required, std::mutex can be used as the LockType directly, if necessary.
     *                 Default is the NullLock, meaning that this target will not be thread-safe.
+    *
+    * The message prefix honours the capability flags of the Logger's traits:
+    * a traits type declaring <tt>static const bool wantsLoggerName = false;</tt>
+    * (and/or wantsTimestamp) has the corresponding prefix-building code
+    * removed at compile time, not merely skipped - a minimal-prefix Logger
+    * typedef pays zero instructions for the unused fields. Both flags
+    * default to true.
+    *
     * \see NullLock for an example of the LockType.
     */
     template <typename OStreamT, typename LockType = NullLock> class OStreamTarget
@@ -64,37 +75,49 @@ namespace Logging
         OStreamT &mOs;
         bool mPrintTime;
         bool mPrintDate;
+        /**
+         * cache for the formatted second-resolution part of the timestamp.
+         * localtime() and strftime() are comparatively expensive (localtime
+         * even takes a global lock in glibc), but their result only changes
+         * once per second - so the formatted prefix is kept here and only
+         * rebuilt when the second actually changes. The per-message work is
+         * reduced to appending the millisecond part.
+         */
+        std::time_t mCachedSecond;
+        char mCachedPrefix[132];
 
         void printTimestamp()
         {
             if (mPrintDate || mPrintTime) {
                 auto time = std::chrono::system_clock::now();
                 auto tp = std::chrono::system_clock::to_time_t(time);
-                char buf[128];
-                char const *fmt;
-                if (mPrintDate) {
-                    if (mPrintTime) {
-                        fmt = "%F %T";
+                if (tp != mCachedSecond) {
+                    char const *fmt;
+                    if (mPrintDate) {
+                        if (mPrintTime) {
+                            fmt = "%F %T";
+                        }
+                        else {
+                            fmt = "%F";
+                        }
                     }
                     else {
-                        fmt = "%F";
+                        fmt = "%T";
                     }
+                    mCachedPrefix[0] = '<';
+                    std::strftime(mCachedPrefix+1, sizeof(mCachedPrefix)-1, fmt, std::localtime(&tp));
+                    mCachedSecond = tp;
                 }
-                else {
-                    fmt = "%T";
-                }
-                std::strftime(buf, 128, fmt, std::localtime(&tp));
-                mOs << "<" << buf;
+                mOs << mCachedPrefix;
                 if (mPrintTime) {
-                    mOs.put('.');
                     auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000; // millisecond part of the equation
-                    auto w = mOs.width();
-                    auto f = mOs.fill();
-                    mOs.width(3);
-                    mOs.fill('0');
-                    mOs << millis;
-                    mOs.width(w);
-                    mOs.fill(f);
+                    char msbuf[5];
+                    msbuf[0] = '.';
+                    msbuf[1] = static_cast<char>('0'+millis/100);
+                    msbuf[2] = static_cast<char>('0'+(millis/10)%10);
+                    msbuf[3] = static_cast<char>('0'+millis%10);
+                    msbuf[4] = '\0';
+                    mOs << msbuf;
                 }
                 mOs << "> ";
             }
@@ -114,7 +137,7 @@ namespace Logging
         *           as long, as the OStreamTarget-object it is wrapped by.
         */
         OStreamTarget(OStreamT &os)
-            : mOs ( os ), mPrintTime( false ), mPrintDate ( false)
+            : mOs ( os ), mPrintTime( false ), mPrintDate ( false), mCachedSecond ( -1 )
         {
         }
 
@@ -128,10 +151,14 @@ namespace Logging
         template <typename LoggerType> void startMessage(LoggerType const &source, TraceLevel tl)
         {
             LockType::lock();
-            std::string const &logName = canonicalName(source);
-            printTimestamp();
-            if (logName.size() > 0) {
-                mOs << '(' << logName << ") ";
+            if (detail::WantsTimestamp<typename LoggerType::TargetTraitsType>::value) {
+                printTimestamp();
+            }
+            if (detail::WantsLoggerName<typename LoggerType::TargetTraitsType>::value) {
+                std::string const &logName = source.canonicalName();
+                if (logName.size() > 0) {
+                    mOs << '(' << logName << ") ";
+                }
             }
             mOs << '[' << levelName(tl) << "] ";
         }
@@ -146,10 +173,14 @@ namespace Logging
         template <typename LoggerType> void startMessage(LoggerType const &source, LogLevel ll)
         {
             LockType::lock();
-            std::string const &logName = canonicalName(source);
-            printTimestamp();
-            if (logName.size() > 0) {
-                mOs << '(' << logName << ") ";
+            if (detail::WantsTimestamp<typename LoggerType::TargetTraitsType>::value) {
+                printTimestamp();
+            }
+            if (detail::WantsLoggerName<typename LoggerType::TargetTraitsType>::value) {
+                std::string const &logName = source.canonicalName();
+                if (logName.size() > 0) {
+                    mOs << '(' << logName << ") ";
+                }
             }
             mOs << '[' << levelName(ll) << "] ";
         }
@@ -192,6 +223,7 @@ namespace Logging
         void printTime(bool p)
         {
             mPrintTime = p;
+            mCachedSecond = -1;  // format changed - invalidate the cached prefix
         }
 
         /**
@@ -202,6 +234,7 @@ namespace Logging
         void printDate(bool p)
         {
             mPrintDate = p;
+            mCachedSecond = -1;  // format changed - invalidate the cached prefix
         }
 
         /**
@@ -226,6 +259,386 @@ namespace Logging
         /// The character traits type of the underlying OStreamTarget
         typedef typename OStreamT::traits_type char_traits_type;
     };
+
+    /**
+    * Buffered variant of the OStreamTarget. While OStreamTarget holds the
+    * lock from startMessage to endMessage (i.e. during all formatting of the
+    * user's values), this target assembles the whole message - timestamp,
+    * logger name, level and values - in a thread-local, reusable buffer
+    * without any locking and only takes the lock for the single write of the
+    * finished line in endMessage. With many threads contending on one target
+    * this shrinks the critical section to one bulk write.
+    *
+    * \tparam OStreamT The type of ostream to use (e.g. std::ostream for things like std::cout).
+    * \tparam LockType The type of Lock adapter to use. See OStreamTarget for the requirements.
+    * \note A single thread assembles one message at a time (the same
+    *       restriction AsyncTarget has).
+    */
+    template <typename OStreamT, typename LockType = NullLock> class BufferedOStreamTarget
+        : public LockType
+    {
+    protected:
+
+        typedef typename OStreamT::char_type char_type;
+        typedef typename OStreamT::traits_type char_traits_type;
+        typedef std::basic_ostringstream<char_type, char_traits_type> buffer_type;
+
+        OStreamT &mOs;
+
+        /// the per-thread assembly buffer. Reused between messages, so its
+        /// internal allocation is only paid once per thread.
+        static buffer_type &buffer()
+        {
+            static thread_local buffer_type buf;
+            return buf;
+        }
+
+    private:
+
+        bool mPrintTime;
+        bool mPrintDate;
+
+        void printTimestamp(buffer_type &os)
+        {
+            if (mPrintDate || mPrintTime) {
+                auto time = std::chrono::system_clock::now();
+                auto tp = std::chrono::system_clock::to_time_t(time);
+                char buf[128];
+                char const *fmt;
+                if (mPrintDate) {
+                    if (mPrintTime) {
+                        fmt = "%F %T";
+                    }
+                    else {
+                        fmt = "%F";
+                    }
+                }
+                else {
+                    fmt = "%T";
+                }
+                std::strftime(buf, 128, fmt, std::localtime(&tp));
+                os << "<" << buf;
+                if (mPrintTime) {
+                    os.put('.');
+                    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000; // millisecond part of the equation
+                    auto w = os.width();
+                    auto f = os.fill();
+                    os.width(3);
+                    os.fill('0');
+                    os << millis;
+                    os.width(w);
+                    os.fill(f);
+                }
+                os << "> ";
+            }
+        }
+
+        /// write the common message prefix into the assembly buffer
+        template <typename LoggerType, typename LevelType> void startPrefix(LoggerType const &source, LevelType level)
+        {
+            buffer_type &os = buffer();
+            if (detail::WantsTimestamp<typename LoggerType::TargetTraitsType>::value) {
+                printTimestamp(os);
+            }
+            if (detail::WantsLoggerName<typename LoggerType::TargetTraitsType>::value) {
+                std::string const &logName = source.canonicalName();
+                if (logName.size() > 0) {
+                    os << '(' << logName << ") ";
+                }
+            }
+            os << '[' << levelName(level) << "] ";
+        }
+
+    public:
+
+        /// The type of output stream wrapped by this object. Used e.g. by TargetTraits
+        typedef OStreamT ostream_type;
+
+        /**
+        * Constructor.
+        * This constructs an object wrapping the given std::ostream.
+        *
+        * \param os The std::ostream to wrap. The target object only wraps a reference to
+        *           the given object. The std::ostream therefore <em>MUST</em> exist at least
+        *           as long, as the BufferedOStreamTarget-object it is wrapped by.
+        */
+        BufferedOStreamTarget(OStreamT &os)
+            : mOs ( os ), mPrintTime( false ), mPrintDate ( false)
+        {
+        }
+
+        /**
+        * Start a message from the given logger with the given level. Unlike
+        * OStreamTarget this does not take the lock - the message prefix is
+        * written into the thread-local assembly buffer.
+        *
+        * \param source the logger object, which starts the message.
+        * \param tl the level of this message
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, TraceLevel tl)
+        {
+            startPrefix(source, tl);
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param ll the level of this message
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, LogLevel ll)
+        {
+            startPrefix(source, ll);
+        }
+
+        /**
+        * finish a message from the given source. The assembled message is
+        * written to the underlying stream in one piece; only this write
+        * happens under the lock.
+        *
+        * \note This method calls LockType::lock(). It might therefore block until the lock is available.
+        */
+        template <typename LoggerType> void endMessage(LoggerType const &)
+        {
+            auto message = buffer().str();
+            buffer().str(std::basic_string<char_type, char_traits_type>());
+            LockType::lock();
+            mOs.write(message.data(), message.size());
+            LockType::unlock();
+        }
+
+        /**
+        * output a value into the thread-local assembly buffer.
+        *
+        * \param v The value. This method has the same effect as <tt>os << v</tt> (with os being the
+        *          assembly buffer of the calling thread).
+        */
+        template <typename LoggerType, typename ValueT> void put(LoggerType const &, ValueT const &v)
+        {
+            buffer() << v;
+        }
+
+        /**
+        * Output stuff like std::endl into the assembly buffer.
+        *
+        * \param manip The manipulator to output.
+        */
+        void put(std::basic_ostream<char>& (*manip)(std::basic_ostream<char>&))
+        {
+            buffer() << manip;
+        }
+
+        /**
+         * print the time a log message is started
+         *
+         * \param p enable/disable printing. If true, printing is enabled.
+         */
+        void printTime(bool p)
+        {
+            mPrintTime = p;
+        }
+
+        /**
+         * print the date a log message is started
+         *
+         * \param p enable/disable printing. If true, printing is enabled.
+         */
+        void printDate(bool p)
+        {
+            mPrintDate = p;
+        }
+
+        /**
+         * print time and date of a log message
+         *
+         * \param p enable/disable printing. If true, printing is enabled.
+         */
+        void printTimestamp(bool p)
+        {
+            printTime(p);
+            printDate(p);
+        }
+    };
+
+    /**
+    * traits class for BufferedOStreamTarget
+    */
+    template <typename OStreamT, typename LockType> struct TargetTraits<BufferedOStreamTarget<OStreamT, LockType>>
+    {
+        /// The character type of the BufferedOStreamTarget
+        typedef typename OStreamT::char_type char_type;
+        /// The character traits type of the underlying BufferedOStreamTarget
+        typedef typename OStreamT::traits_type char_traits_type;
+    };
+
+    /**
+    * Write-combining variant of the BufferedOStreamTarget. Completed
+    * messages are not handed to the underlying stream one by one but
+    * collected in a large internal batch buffer; the batch is written out in
+    * one piece when it reaches the configured size, when the configured time
+    * bound since the last flush has expired or when a FATAL message arrives
+    * (write-through, so the last words of a dying process are not stuck in
+    * the batch). Amortizing the stream writes over many messages avoids the
+    * one-kernel-write-per-few-messages pattern iostreams produce under load.
+    *
+    * Call flush() before shutdown to push out whatever is still batched (the
+    * destructor does so as well).
+    *
+    * \tparam OStreamT The type of ostream to use (e.g. std::ofstream for a log file).
+    * \tparam LockType The type of Lock adapter to use. See OStreamTarget for the requirements.
+    */
+    template <typename OStreamT, typename LockType = NullLock> class BatchedOStreamTarget
+        : public BufferedOStreamTarget<OStreamT, LockType>
+    {
+        typedef BufferedOStreamTarget<OStreamT, LockType> Base;
+
+        std::basic_string<typename Base::char_type, typename Base::char_traits_type> mBatch;
+        std::size_t mFlushSize;
+        std::chrono::steady_clock::duration mFlushInterval;
+        std::chrono::steady_clock::time_point mLastFlush;
+        /// the scheduler this target registered with, if any
+        FlushScheduler *mScheduler;
+        FlushScheduler::Ticket mTicket;
+
+        /// the level of the message the calling thread is currently assembling
+        static unsigned char &currentLevel()
+        {
+            static thread_local unsigned char level;
+            return level;
+        }
+
+        /// write the batch out. Must be called with the lock held.
+        void flushBatch()
+        {
+            Base::mOs.write(mBatch.data(), mBatch.size());
+            Base::mOs.flush();
+            mBatch.clear();  // keeps the capacity
+            mLastFlush = std::chrono::steady_clock::now();
+        }
+
+    public:
+
+        /**
+        * Constructor.
+        *
+        * \param os The std::ostream to wrap. Must outlive this object (see OStreamTarget).
+        * \param flushSize Write the batch out once it holds at least this many characters.
+        * \param flushInterval Write the batch out at the latest when a message completes
+        *                      this long after the previous flush.
+        */
+        BatchedOStreamTarget(OStreamT &os, std::size_t flushSize = 64*1024,
+                             std::chrono::milliseconds flushInterval = std::chrono::milliseconds(1000))
+            : Base(os), mFlushSize(flushSize), mFlushInterval(flushInterval),
+              mLastFlush(std::chrono::steady_clock::now()),
+              mScheduler(nullptr), mTicket(0)
+        {
+        }
+
+        /**
+        * Constructor registering with a FlushScheduler. The time-based
+        * flushing is handed to the scheduler's worker pool, so no logging
+        * thread ever performs it; only the size bound and the FATAL
+        * write-through still flush from the logging thread. The target
+        * detaches itself on destruction.
+        *
+        * \param os The std::ostream to wrap. Must outlive this object (see OStreamTarget).
+        * \param scheduler The scheduler flushing this target. Must outlive this object.
+        * \param flushSize Write the batch out once it holds at least this many characters.
+        * \note The scheduler flushes from a worker thread, so this
+        *       constructor requires a real LockType: with the NullLock the
+        *       worker's flush() would race with endMessage() on the batch
+        *       and the stream even when only a single thread logs.
+        */
+        BatchedOStreamTarget(OStreamT &os, FlushScheduler &scheduler,
+                             std::size_t flushSize = 64*1024)
+            : Base(os), mFlushSize(flushSize),
+              // the scheduler owns the time bound now - disable the local one
+              mFlushInterval(std::chrono::steady_clock::duration::max()),
+              mLastFlush(std::chrono::steady_clock::now()),
+              mScheduler(&scheduler), mTicket(scheduler.attach(*this))
+        {
+            static_assert(!std::is_same<LockType, NullLock>::value,
+                          "a scheduler-attached BatchedOStreamTarget is flushed from a worker "
+                          "thread and needs a real LockType (e.g. std::mutex), not the NullLock");
+        }
+
+        ~BatchedOStreamTarget()
+        {
+            if (mScheduler) {
+                mScheduler->detach(mTicket);
+            }
+            flush();
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param tl the level of this message
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, TraceLevel tl)
+        {
+            currentLevel() = tl;
+            Base::startMessage(source, tl);
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param ll the level of this message
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, LogLevel ll)
+        {
+            currentLevel() = ll;
+            Base::startMessage(source, ll);
+        }
+
+        /**
+        * finish a message from the given source. The assembled message is
+        * appended to the batch; the batch is only written to the stream when
+        * a flush is due.
+        *
+        * \note This method calls LockType::lock(). It might therefore block until the lock is available.
+        */
+        template <typename LoggerType> void endMessage(LoggerType const &)
+        {
+            auto message = Base::buffer().str();
+            Base::buffer().str(std::basic_string<typename Base::char_type, typename Base::char_traits_type>());
+            LockType::lock();
+            mBatch += message;
+            if (mBatch.size() >= mFlushSize
+                || std::chrono::steady_clock::now()-mLastFlush >= mFlushInterval
+                || currentLevel() >= LEVEL_FATAL) {
+                flushBatch();
+            }
+            LockType::unlock();
+        }
+
+        /**
+        * Write out whatever is currently batched. Call this on shutdown (or
+        * whenever batched messages must become visible immediately).
+        *
+        * \note This method calls LockType::lock(). It might therefore block until the lock is available.
+        */
+        void flush()
+        {
+            LockType::lock();
+            flushBatch();
+            LockType::unlock();
+        }
+    };
+
+    /**
+    * traits class for BatchedOStreamTarget
+    */
+    template <typename OStreamT, typename LockType> struct TargetTraits<BatchedOStreamTarget<OStreamT, LockType>>
+    {
+        /// The character type of the BatchedOStreamTarget
+        typedef typename OStreamT::char_type char_type;
+        /// The character traits type of the underlying BatchedOStreamTarget
+        typedef typename OStreamT::traits_type char_traits_type;
+    };
 }
 
 #endif // OSTREAMLOGGER_HXX
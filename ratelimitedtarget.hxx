@@ -0,0 +1,253 @@
+#ifndef RATELIMITEDTARGET_HXX
+#define RATELIMITEDTARGET_HXX
+
+/*
+Copyright (c) 2014, Markus Brueckner <namenlos@geekbetrieb.de>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither my name nor the names of any contributors may be used to endorse
+      or promote products derived from this software without specific prior
+      written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL I, THE AUTHOR OF THIS SOFTWARE, BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "logging.hxx"
+
+namespace Logging
+{
+    /**
+    * Pseudo-target suppressing message floods before they reach the wrapped
+    * target. Admission is tracked per (logger, level) key in a fixed-size
+    * table of atomic counting slots: each key may emit a configurable number
+    * of messages per time window, everything beyond that is dropped before
+    * the sub-target's startMessage (no lock, no timestamp, no formatting).
+    * When a window with suppressed messages rolls over, a single
+    * "last message repeated N times" summary is emitted.
+    *
+    * The suppressed-path cost is one hash probe over the slot table plus a
+    * handful of relaxed atomics; the table never allocates after
+    * construction. Keys hashing to the same slot share a budget - with the
+    * default table size of 1024 slots that is rare and at worst makes the
+    * limiter slightly stricter. The counting is intentionally approximate
+    * under contention; a flood is cut off either way.
+    *
+    * \tparam SubTarget The target type actually delivering the admitted messages.
+    */
+    template <typename SubTarget> class RateLimitedTarget
+    {
+        struct Slot
+        {
+            std::atomic<std::uintptr_t> key;
+            std::atomic<std::uint32_t> count;       // admissions in the current window
+            std::atomic<std::uint32_t> suppressed;  // drops in the current window
+            std::atomic<std::int64_t> windowStart;  // steady clock, nanoseconds
+        };
+
+        std::shared_ptr<SubTarget> mSubTarget;
+        std::unique_ptr<Slot[]> mSlots;
+        std::size_t mMask;
+        std::uint32_t mMaxPerWindow;
+        std::int64_t mWindowNanos;
+        std::atomic<unsigned long long> mSuppressedTotal;
+
+        /// whether the message the calling thread currently builds was admitted
+        static bool &admitted()
+        {
+            static thread_local bool a = true;
+            return a;
+        }
+
+        static std::int64_t nowNanos()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /// mix the (logger, level) pair into a table key; 0 marks a free slot
+        template <typename LoggerType> static std::uintptr_t makeKey(LoggerType const *source, unsigned char level)
+        {
+            std::uintptr_t key = reinterpret_cast<std::uintptr_t>(source) ^ (static_cast<std::uintptr_t>(level) << 1);
+            return key == 0 ? 1 : key;
+        }
+
+        /**
+        * decide whether the message may pass and emit a pending summary for
+        * its slot when the window rolled over.
+        *
+        * \return true, if the message is admitted.
+        */
+        template <typename LoggerType, typename LevelType> bool admit(LoggerType const &source, LevelType level)
+        {
+            std::uintptr_t key = makeKey(&source, level);
+            Slot &slot = mSlots[(key*2654435761u) & mMask];
+            std::uintptr_t occupant = slot.key.load(std::memory_order_relaxed);
+            if (occupant != key) {
+                // take the slot over (eviction is benign, see class comment)
+                slot.key.store(key, std::memory_order_relaxed);
+                slot.count.store(0, std::memory_order_relaxed);
+                slot.suppressed.store(0, std::memory_order_relaxed);
+                slot.windowStart.store(nowNanos(), std::memory_order_relaxed);
+            }
+            else if (nowNanos()-slot.windowStart.load(std::memory_order_relaxed) >= mWindowNanos) {
+                std::uint32_t repeats = slot.suppressed.exchange(0, std::memory_order_relaxed);
+                slot.count.store(0, std::memory_order_relaxed);
+                slot.windowStart.store(nowNanos(), std::memory_order_relaxed);
+                if (repeats > 0) {
+                    mSubTarget->startMessage(source, level);
+                    mSubTarget->put(source, "last message repeated ");
+                    mSubTarget->put(source, repeats);
+                    mSubTarget->put(source, " times\n");
+                    mSubTarget->endMessage(source);
+                }
+            }
+            if (slot.count.fetch_add(1, std::memory_order_relaxed) < mMaxPerWindow) {
+                return true;
+            }
+            slot.suppressed.fetch_add(1, std::memory_order_relaxed);
+            mSuppressedTotal.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+    public:
+
+        /**
+        * Constructor.
+        *
+        * \param subTarget The target delivering the admitted messages.
+        * \param maxPerWindow How many messages each (logger, level) key may emit per window.
+        * \param window The length of the counting window.
+        * \param slots The size of the counting table. Rounded up to a power of two.
+        */
+        RateLimitedTarget(std::shared_ptr<SubTarget> const &subTarget,
+                          std::uint32_t maxPerWindow = 10,
+                          std::chrono::milliseconds window = std::chrono::milliseconds(1000),
+                          std::size_t slots = 1024)
+            : mSubTarget(subTarget), mMaxPerWindow(maxPerWindow),
+              mWindowNanos(std::chrono::duration_cast<std::chrono::nanoseconds>(window).count()),
+              mSuppressedTotal(0)
+        {
+            std::size_t n = 1;
+            while (n < slots) {
+                n <<= 1;
+            }
+            mMask = n-1;
+            mSlots.reset(new Slot[n]);
+            for (std::size_t i = 0; i < n; ++i) {
+                mSlots[i].key.store(0, std::memory_order_relaxed);
+                mSlots[i].count.store(0, std::memory_order_relaxed);
+                mSlots[i].suppressed.store(0, std::memory_order_relaxed);
+                mSlots[i].windowStart.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+        * Start a message from the given logger with the given level. Only
+        * admitted messages ever reach the wrapped target.
+        *
+        * \param source the logger object, which starts the message.
+        * \param tl the level of this message
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, TraceLevel tl)
+        {
+            admitted() = admit(source, tl);
+            if (admitted()) {
+                mSubTarget->startMessage(source, tl);
+            }
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param ll the level of this message
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, LogLevel ll)
+        {
+            admitted() = admit(source, ll);
+            if (admitted()) {
+                mSubTarget->startMessage(source, ll);
+            }
+        }
+
+        /**
+        * finish a message from the given source (if it was admitted).
+        */
+        template <typename LoggerType> void endMessage(LoggerType const &source)
+        {
+            if (admitted()) {
+                mSubTarget->endMessage(source);
+            }
+        }
+
+        /**
+        * output a value (if the current message was admitted). The value's
+        * category is preserved, so the wrapped target may move from
+        * temporaries.
+        *
+        * \param v The value to forward to the wrapped target.
+        */
+        template <typename LoggerType, typename ValueT> void put(LoggerType const &source, ValueT &&v)
+        {
+            if (admitted()) {
+                mSubTarget->put(source, std::forward<ValueT>(v));
+            }
+        }
+
+        /**
+        * Output stuff like std::endl (if the current message was admitted).
+        *
+        * \param manip The manipulator to forward.
+        */
+        void put(std::basic_ostream<char>& (*manip)(std::basic_ostream<char>&))
+        {
+            if (admitted()) {
+                mSubTarget->put(manip);
+            }
+        }
+
+        /**
+        * total number of messages suppressed since construction.
+        *
+        * \return the number of suppressed messages
+        */
+        unsigned long long suppressedMessages() const
+        {
+            return mSuppressedTotal.load(std::memory_order_relaxed);
+        }
+    };
+
+    /**
+    * traits specialization for the RateLimitedTarget. As with the other
+    * wrapper targets, only the common char-output can be promised.
+    */
+    template <typename SubTarget> struct TargetTraits<RateLimitedTarget<SubTarget>>
+    {
+        typedef char char_type;
+        typedef std::char_traits<char> char_traits_type;
+    };
+}
+
+#endif // RATELIMITEDTARGET_HXX
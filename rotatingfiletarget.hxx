@@ -0,0 +1,381 @@
+#ifndef ROTATINGFILETARGET_HXX
+#define ROTATINGFILETARGET_HXX
+
+/*
+Copyright (c) 2014, Markus Brueckner <namenlos@geekbetrieb.de>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither my name nor the names of any contributors may be used to endorse
+      or promote products derived from this software without specific prior
+      written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL I, THE AUTHOR OF THIS SOFTWARE, BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logging.hxx"
+#include "logging_utils.hxx"
+#include "locking.hxx"
+
+namespace Logging
+{
+    /**
+    * Logging target writing to a file that is rotated by size and/or age
+    * without stalling the logging threads. The next segment file is opened
+    * and preallocated ahead of time by a background thread, so crossing a
+    * rotation boundary on the hot path is nothing but swapping one file
+    * descriptor for the already prepared one; closing the old segment,
+    * renaming the files and any post-processing (e.g. compression, via the
+    * onSegmentFinished() hook) happen on the background thread.
+    *
+    * The active file always carries the configured name; finished segments
+    * are renamed to "<name>.1", "<name>.2" and so on in rotation order.
+    *
+    * \tparam LockType The type of Lock adapter to use. See OStreamTarget for the requirements.
+    */
+    template <typename LockType = NullLock> class RotatingFileTarget : public LockType
+    {
+        /// work item for the background rotation thread
+        struct Job
+        {
+            int oldFd;            // the finished segment's descriptor, -1 for the initial prepare
+            std::uint64_t index;  // the number the finished segment is renamed to
+        };
+
+        std::string mFileName;
+        std::uint64_t mMaxSize;
+        std::chrono::seconds mMaxAge;
+        int mFd;
+        std::atomic<int> mNextFd;  // the prepared next segment, -1 while preparation is pending
+        std::uint64_t mBytesWritten;
+        std::uint64_t mIndex;      // number of rotations so far
+        std::chrono::steady_clock::time_point mSegmentStart;
+        std::string mBuffer;
+        std::function<void(std::string const &)> mOnSegmentFinished;
+
+        std::deque<Job> mJobs;
+        std::mutex mJobsMutex;
+        std::condition_variable mJobsCondition;
+        bool mStopped;
+        std::thread mWorker;
+
+        /// path of the prepared-in-advance next segment file
+        std::string nextName() const
+        {
+            return mFileName+".next";
+        }
+
+        /// open and preallocate a fresh segment file under the .next name
+        int prepareSegment()
+        {
+            int fd = ::open(nextName().c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+            if (fd >= 0 && mMaxSize > 0) {
+                // best effort - a filesystem without fallocate support just
+                // loses the preallocation, not the rotation
+                if (::posix_fallocate(fd, 0, mMaxSize) != 0) {
+                    auto truncated = ::ftruncate(fd, 0);
+                    (void)truncated;
+                }
+            }
+            return fd;
+        }
+
+        /// main loop of the background rotation thread
+        void work()
+        {
+            for (;;) {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> guard(mJobsMutex);
+                    mJobsCondition.wait(guard, [this] { return mStopped || !mJobs.empty(); });
+                    if (mJobs.empty()) {
+                        return;
+                    }
+                    job = mJobs.front();
+                    mJobs.pop_front();
+                }
+                if (job.oldFd >= 0) {
+                    // cut the preallocated tail off and retire the segment.
+                    // The renames are safe while descriptors are still open -
+                    // they follow their inodes, not the names.
+                    auto truncated = ::ftruncate(job.oldFd, ::lseek(job.oldFd, 0, SEEK_CUR));
+                    (void)truncated;
+                    ::close(job.oldFd);
+                    std::string finished = mFileName+"."+std::to_string(job.index);
+                    ::rename(mFileName.c_str(), finished.c_str());
+                    ::rename(nextName().c_str(), mFileName.c_str());
+                    if (mOnSegmentFinished) {
+                        mOnSegmentFinished(finished);
+                    }
+                }
+                mNextFd.store(prepareSegment(), std::memory_order_release);
+            }
+        }
+
+        /// swap in the prepared segment, if one is ready, and hand the old one off
+        void rotate()
+        {
+            int nextFd = mNextFd.exchange(-1, std::memory_order_acquire);
+            if (nextFd < 0) {
+                // preparation still pending - keep writing to the current
+                // segment and try again on the next message
+                return;
+            }
+            Job job { mFd, ++mIndex };
+            mFd = nextFd;
+            mBytesWritten = 0;
+            mSegmentStart = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> guard(mJobsMutex);
+            mJobs.push_back(job);
+            mJobsCondition.notify_one();
+        }
+
+        /// write the common "(name) [LEVEL] " prefix into the assembly buffer
+        template <typename LoggerType> void startPrefix(LoggerType const &source, char const *level)
+        {
+            std::string const &logName = source.canonicalName();
+            if (logName.size() > 0) {
+                mBuffer += '(';
+                mBuffer += logName;
+                mBuffer += ") ";
+            }
+            mBuffer += '[';
+            mBuffer += level;
+            mBuffer += "] ";
+        }
+
+    public:
+
+        /**
+        * Constructor.
+        *
+        * \param fileName The name of the active log file. Appended to if it
+        *                 already exists.
+        * \param maxSize Rotate when the active segment reaches this many
+        *                bytes. 0 disables size-based rotation.
+        * \param maxAge Rotate when the active segment reaches this age.
+        *               Zero seconds (the default) disables time-based rotation.
+        */
+        explicit RotatingFileTarget(char const *fileName,
+                                    std::uint64_t maxSize = 64*1024*1024,
+                                    std::chrono::seconds maxAge = std::chrono::seconds(0))
+            : mFileName(fileName), mMaxSize(maxSize), mMaxAge(maxAge),
+              mFd(::open(fileName, O_WRONLY|O_CREAT|O_APPEND, 0644)), mNextFd(-1),
+              mBytesWritten(0), mIndex(0), mSegmentStart(std::chrono::steady_clock::now()),
+              mStopped(false)
+        {
+            if (mFd < 0) {
+                throw std::runtime_error(std::string("could not open log file ")+fileName);
+            }
+            off_t existing = ::lseek(mFd, 0, SEEK_END);
+            if (existing > 0) {
+                mBytesWritten = existing;
+            }
+            // count past segments so retired names keep increasing
+            struct stat st;
+            while (::stat((mFileName+"."+std::to_string(mIndex+1)).c_str(), &st) == 0) {
+                ++mIndex;
+            }
+            mJobs.push_back(Job { -1, 0 });  // prepare the first next segment
+            mWorker = std::thread(&RotatingFileTarget::work, this);
+        }
+
+        RotatingFileTarget(RotatingFileTarget const &) = delete;
+        RotatingFileTarget &operator=(RotatingFileTarget const &) = delete;
+
+        /**
+        * Destructor. Finishes pending rotation work, then closes the active
+        * segment and removes the unused prepared one.
+        */
+        ~RotatingFileTarget()
+        {
+            {
+                std::lock_guard<std::mutex> guard(mJobsMutex);
+                mStopped = true;
+                mJobsCondition.notify_one();
+            }
+            mWorker.join();
+            // give the unused preallocated tail of the active segment back
+            auto truncated = ::ftruncate(mFd, ::lseek(mFd, 0, SEEK_CUR));
+            (void)truncated;
+            ::close(mFd);
+            int nextFd = mNextFd.load(std::memory_order_acquire);
+            if (nextFd >= 0) {
+                ::close(nextFd);
+                ::unlink(nextName().c_str());
+            }
+        }
+
+        /**
+        * Install a hook invoked on the background thread with the path of
+        * every finished, renamed segment - the place to hang compression or
+        * shipping off without touching the logging threads.
+        *
+        * \param hook The function to call for each finished segment.
+        */
+        void onSegmentFinished(std::function<void(std::string const &)> hook)
+        {
+            mOnSegmentFinished = std::move(hook);
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param tl the level of this message
+        * \note This method calls LockType::lock(). It might therefore block until the lock is available.
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, TraceLevel tl)
+        {
+            LockType::lock();
+            startPrefix(source, levelName(tl));
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param ll the level of this message
+        * \note This method calls LockType::lock(). It might therefore block until the lock is available.
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, LogLevel ll)
+        {
+            LockType::lock();
+            startPrefix(source, levelName(ll));
+        }
+
+        /**
+        * finish a message from the given source. The assembled line is
+        * written to the active segment; if that pushes the segment over its
+        * size or age limit, the prepared descriptor is swapped in.
+        */
+        template <typename LoggerType> void endMessage(LoggerType const &)
+        {
+            mBuffer += '\n';
+            auto written = ::write(mFd, mBuffer.data(), mBuffer.size());
+            (void)written;
+            mBytesWritten += mBuffer.size();
+            mBuffer.clear();
+            if ((mMaxSize > 0 && mBytesWritten >= mMaxSize)
+                || (mMaxAge.count() > 0
+                    && std::chrono::steady_clock::now()-mSegmentStart >= mMaxAge)) {
+                rotate();
+            }
+            LockType::unlock();
+        }
+
+        /// output a signed integral value to the assembly buffer
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<std::is_integral<ValueT>::value && std::is_signed<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            char buf[24];
+            int len = std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v));
+            mBuffer.append(buf, len);
+        }
+
+        /// output an unsigned integral value to the assembly buffer
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<std::is_integral<ValueT>::value && std::is_unsigned<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            char buf[24];
+            int len = std::snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(v));
+            mBuffer.append(buf, len);
+        }
+
+        /// output a floating point value to the assembly buffer
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<std::is_floating_point<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            char buf[32];
+            int len = std::snprintf(buf, sizeof(buf), "%g", static_cast<double>(v));
+            mBuffer.append(buf, len);
+        }
+
+        /// output a single character to the assembly buffer
+        template <typename LoggerType> void put(LoggerType const &, char const &v)
+        {
+            mBuffer += v;
+        }
+
+        /// output a C string to the assembly buffer
+        template <typename LoggerType> void put(LoggerType const &, char const * const &v)
+        {
+            mBuffer += v;
+        }
+
+        /// output a string to the assembly buffer
+        template <typename LoggerType> void put(LoggerType const &, std::string const &v)
+        {
+            mBuffer += v;
+        }
+
+        /// output any other value via iostream formatting
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<!std::is_arithmetic<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            std::ostringstream os;
+            os << v;
+            mBuffer += os.str();
+        }
+
+        /**
+        * Output stuff like std::endl to the buffer. std::endl degrades to a
+        * plain newline here; the descriptor is not buffered in user space.
+        *
+        * \param manip The manipulator to output.
+        */
+        void put(std::basic_ostream<char>& (*manip)(std::basic_ostream<char>&))
+        {
+            std::ostringstream os;
+            os << manip;
+            mBuffer += os.str();
+        }
+    };
+
+    /**
+     * traits specialization for the RotatingFileTarget
+     */
+    template <typename LockType> struct TargetTraits<RotatingFileTarget<LockType>>
+    {
+        typedef char char_type;
+        typedef std::char_traits<char> char_traits_type;
+    };
+}
+#endif // ROTATINGFILETARGET_HXX
@@ -0,0 +1,194 @@
+#ifndef SAMPLINGTARGET_HXX
+#define SAMPLINGTARGET_HXX
+
+/*
+Copyright (c) 2014, Markus Brueckner <namenlos@geekbetrieb.de>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither my name nor the names of any contributors may be used to endorse
+      or promote products derived from this software without specific prior
+      written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL I, THE AUTHOR OF THIS SOFTWARE, BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "logging.hxx"
+
+namespace Logging
+{
+    /**
+    * Pseudo-target admitting only every N-th message to the wrapped target.
+    * The use case is DEBUG-level visibility on production hot paths: fully
+    * enabled is too slow, disabled is blind - sampled at 1-in-1000 the
+    * volume is gone but the path stays observable. Wrap the sub-target of a
+    * dedicated child logger subtree to sample one subsystem.
+    *
+    * Admission costs one thread-local counter decrement, decided before the
+    * sub-target's startMessage is ever invoked: a rejected message takes no
+    * lock, no timestamp and no name lookup, it is a decrement and a branch.
+    * Each thread counts for itself (the counter is a plain thread_local, not
+    * a contended atomic), starting at 1 so every thread's first message gets
+    * through; across threads the admitted fraction is still 1/N.
+    *
+    * \note The counter is per thread and target TYPE, not per target
+    *       instance - two SamplingTarget<X> instances in one process share
+    *       the countdown. With the intended one-sampler-per-subsystem setup
+    *       (distinct sub-target types or a single sampler) this does not
+    *       matter; it keeps the admission path free of any instance lookup.
+    *
+    * \tparam SubTarget The target type actually delivering the sampled messages.
+    */
+    template <typename SubTarget> class SamplingTarget
+    {
+        std::shared_ptr<SubTarget> mSubTarget;
+        std::uint32_t mEvery;
+        std::atomic<unsigned long long> mAdmittedTotal;
+
+        /// whether the message the calling thread currently builds was admitted
+        static bool &admitted()
+        {
+            static thread_local bool a = true;
+            return a;
+        }
+
+        /// the calling thread's countdown to the next admitted message
+        static std::uint32_t &countdown()
+        {
+            static thread_local std::uint32_t c = 1;
+            return c;
+        }
+
+        /// the 1-in-N admission decision: a decrement and a branch
+        bool admit()
+        {
+            if (--countdown() > 0) {
+                return false;
+            }
+            countdown() = mEvery;
+            mAdmittedTotal.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+    public:
+
+        /**
+        * Constructor.
+        *
+        * \param subTarget The target delivering the sampled messages.
+        * \param every Admit one message in this many (per thread). 1 passes
+        *              everything through.
+        */
+        SamplingTarget(std::shared_ptr<SubTarget> const &subTarget, std::uint32_t every = 1000)
+            : mSubTarget(subTarget), mEvery(every > 0 ? every : 1), mAdmittedTotal(0)
+        {
+        }
+
+        /**
+        * Start a message from the given logger with the given level. Only
+        * every N-th message reaches the wrapped target.
+        *
+        * \param source the logger object, which starts the message.
+        * \param tl the level of this message
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, TraceLevel tl)
+        {
+            admitted() = admit();
+            if (admitted()) {
+                mSubTarget->startMessage(source, tl);
+            }
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param ll the level of this message
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, LogLevel ll)
+        {
+            admitted() = admit();
+            if (admitted()) {
+                mSubTarget->startMessage(source, ll);
+            }
+        }
+
+        /**
+        * finish a message from the given source (if it was admitted).
+        */
+        template <typename LoggerType> void endMessage(LoggerType const &source)
+        {
+            if (admitted()) {
+                mSubTarget->endMessage(source);
+            }
+        }
+
+        /**
+        * output a value (if the current message was admitted). The value's
+        * category is preserved, so the wrapped target may move from
+        * temporaries.
+        *
+        * \param v The value to forward to the wrapped target.
+        */
+        template <typename LoggerType, typename ValueT> void put(LoggerType const &source, ValueT &&v)
+        {
+            if (admitted()) {
+                mSubTarget->put(source, std::forward<ValueT>(v));
+            }
+        }
+
+        /**
+        * Output stuff like std::endl (if the current message was admitted).
+        *
+        * \param manip The manipulator to forward.
+        */
+        void put(std::basic_ostream<char>& (*manip)(std::basic_ostream<char>&))
+        {
+            if (admitted()) {
+                mSubTarget->put(manip);
+            }
+        }
+
+        /**
+        * total number of messages admitted since construction.
+        *
+        * \return the number of admitted messages
+        */
+        unsigned long long admittedMessages() const
+        {
+            return mAdmittedTotal.load(std::memory_order_relaxed);
+        }
+    };
+
+    /**
+    * traits specialization for the SamplingTarget. As with the other
+    * wrapper targets, only the common char-output can be promised.
+    */
+    template <typename SubTarget> struct TargetTraits<SamplingTarget<SubTarget>>
+    {
+        typedef char char_type;
+        typedef std::char_traits<char> char_traits_type;
+    };
+}
+
+#endif // SAMPLINGTARGET_HXX
@@ -0,0 +1,296 @@
+#ifndef SHARDEDTARGET_HXX
+#define SHARDEDTARGET_HXX
+
+/*
+Copyright (c) 2014, Markus Brueckner <namenlos@geekbetrieb.de>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither my name nor the names of any contributors may be used to endorse
+      or promote products derived from this software without specific prior
+      written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL I, THE AUTHOR OF THIS SOFTWARE, BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "logging.hxx"
+#include "logrecord.hxx"
+
+namespace Logging
+{
+    /**
+    * Pseudo-target removing the global serialization point of a single
+    * locked target. Every logging thread writes completed messages into its
+    * own shard (created on first use), so producers never contend with each
+    * other; a collector thread periodically gathers the shards, merges the
+    * messages in timestamp order and replays them into the downstream
+    * target. Existing Logger typedefs can switch to this by wrapping their
+    * target type, e.g.
+    * \code
+    *     typedef Logging::ShardedTarget<Logging::OStreamTarget<std::ostream>> LogTarget;
+    * \endcode
+    *
+    * The producer-side cost per message is one push into the thread's own
+    * shard under the shard's (practically always uncontended) handoff mutex.
+    *
+    * \tparam SubTarget The downstream target type the collector delivers to.
+    */
+    template <typename SubTarget> class ShardedTarget
+    {
+        /// a captured message plus its position in the merge order
+        struct TimedRecord
+        {
+            std::chrono::steady_clock::time_point timestamp;
+            LogRecord record;
+
+            bool operator<(TimedRecord const &other) const
+            {
+                return timestamp < other.timestamp;
+            }
+        };
+
+        /// the per-thread message buffer
+        struct Shard
+        {
+            std::mutex handoff;  // taken briefly by the owner on push and by the collector on swap
+            std::vector<TimedRecord> records;
+        };
+
+        /// per-thread assembly state for the message currently being built
+        struct Assembly
+        {
+            std::ostringstream os;
+            std::string loggerName;
+            unsigned char level;
+            bool isTrace;
+        };
+
+        /// cache entry mapping a target instance to the calling thread's shard
+        struct ShardRef
+        {
+            ShardedTarget const *owner;
+            std::uint64_t generation;
+            Shard *shard;
+        };
+
+        std::shared_ptr<SubTarget> mDownstream;
+        std::chrono::milliseconds mCollectInterval;
+        std::vector<std::unique_ptr<Shard>> mShards;
+        std::mutex mShardsMutex;  // guards shard creation only
+        std::uint64_t mGeneration;
+        std::atomic<bool> mStopped;
+        std::thread mCollector;
+
+        /// process-wide source of instance generations, telling apart
+        /// targets that reuse the address of a destroyed one
+        static std::atomic<std::uint64_t> &generationCounter()
+        {
+            static std::atomic<std::uint64_t> counter(0);
+            return counter;
+        }
+
+        static Assembly &assembly()
+        {
+            static thread_local Assembly a;
+            return a;
+        }
+
+        /// allocate a fresh shard for the calling thread. Must not hold mShardsMutex.
+        Shard *newShard()
+        {
+            std::lock_guard<std::mutex> guard(mShardsMutex);
+            mShards.emplace_back(new Shard());
+            return mShards.back().get();
+        }
+
+        /**
+        * the calling thread's shard of this target, created on first use.
+        * Cache entries carry the generation of the instance they were made
+        * for: a ShardedTarget allocated at the address of a destroyed one
+        * has a different generation, so a stale entry never resolves into
+        * the dead target's freed shard - it is refreshed in place instead.
+        */
+        Shard &myShard()
+        {
+            static thread_local std::vector<ShardRef> cache;
+            for (auto &entry : cache) {
+                if (entry.owner == this) {
+                    if (entry.generation != mGeneration) {
+                        entry.generation = mGeneration;
+                        entry.shard = newShard();
+                    }
+                    return *entry.shard;
+                }
+            }
+            Shard *shard = newShard();
+            cache.push_back(ShardRef { this, mGeneration, shard });
+            return *shard;
+        }
+
+        /// gather all shards, merge by timestamp and deliver downstream
+        void collect()
+        {
+            std::vector<TimedRecord> merged;
+            {
+                std::lock_guard<std::mutex> guard(mShardsMutex);
+                for (auto &shard : mShards) {
+                    std::lock_guard<std::mutex> handoffGuard(shard->handoff);
+                    merged.insert(merged.end(),
+                                  std::make_move_iterator(shard->records.begin()),
+                                  std::make_move_iterator(shard->records.end()));
+                    shard->records.clear();
+                }
+            }
+            std::stable_sort(merged.begin(), merged.end());
+            for (auto const &timed : merged) {
+                deliverRecord(*mDownstream, timed.record);
+            }
+        }
+
+        /// main loop of the collector thread
+        void run()
+        {
+            for (;;) {
+                bool stopped = mStopped.load(std::memory_order_acquire);
+                collect();
+                if (stopped) {
+                    break;  // one final collection after the stop flag was seen
+                }
+                std::this_thread::sleep_for(mCollectInterval);
+            }
+        }
+
+    public:
+
+        /**
+        * Constructor.
+        *
+        * \param downstream The target the collector thread merges the messages into.
+        * \param collectInterval How often the collector gathers the shards. This
+        *                        bounds the delay until a message becomes visible.
+        */
+        ShardedTarget(std::shared_ptr<SubTarget> const &downstream,
+                      std::chrono::milliseconds collectInterval = std::chrono::milliseconds(10))
+            : mDownstream(downstream), mCollectInterval(collectInterval),
+              mGeneration(generationCounter().fetch_add(1, std::memory_order_relaxed)+1),
+              mStopped(false)
+        {
+            mCollector = std::thread(&ShardedTarget::run, this);
+        }
+
+        ShardedTarget(ShardedTarget const &) = delete;
+        ShardedTarget &operator=(ShardedTarget const &) = delete;
+
+        /**
+        * Destructor. Collects and delivers all remaining messages before
+        * shutting the collector down.
+        */
+        ~ShardedTarget()
+        {
+            mStopped.store(true, std::memory_order_release);
+            mCollector.join();
+        }
+
+        /**
+        * Start a message from the given logger with the given level. Does
+        * not lock anything - assembly happens in thread-local state.
+        *
+        * \param source the logger object, which starts the message.
+        * \param tl the level of this message
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, TraceLevel tl)
+        {
+            Assembly &a = assembly();
+            a.loggerName = source.canonicalName();
+            a.level = tl;
+            a.isTrace = true;
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param ll the level of this message
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, LogLevel ll)
+        {
+            Assembly &a = assembly();
+            a.loggerName = source.canonicalName();
+            a.level = ll;
+            a.isTrace = false;
+        }
+
+        /**
+        * finish a message from the given source. The finished record is
+        * timestamped and pushed into the calling thread's own shard.
+        */
+        template <typename LoggerType> void endMessage(LoggerType const &)
+        {
+            Assembly &a = assembly();
+            TimedRecord timed { std::chrono::steady_clock::now(),
+                                LogRecord { std::move(a.loggerName), a.os.str(), a.level, a.isTrace } };
+            a.os.str(std::string());
+            Shard &shard = myShard();
+            std::lock_guard<std::mutex> guard(shard.handoff);
+            shard.records.push_back(std::move(timed));
+        }
+
+        /**
+        * output a value into the thread-local assembly buffer.
+        *
+        * \param v The value. This method has the same effect as <tt>os << v</tt> (with os being the
+        *          assembly buffer of the calling thread).
+        */
+        template <typename LoggerType, typename ValueT> void put(LoggerType const &, ValueT const &v)
+        {
+            assembly().os << v;
+        }
+
+        /**
+        * Output stuff like std::endl into the assembly buffer.
+        *
+        * \param manip The manipulator to output.
+        */
+        void put(std::basic_ostream<char>& (*manip)(std::basic_ostream<char>&))
+        {
+            assembly().os << manip;
+        }
+    };
+
+    /**
+    * traits specialization for the ShardedTarget. As with the other wrapper
+    * targets, only the common char-output can be promised here.
+    */
+    template <typename SubTarget> struct TargetTraits<ShardedTarget<SubTarget>>
+    {
+        typedef char char_type;
+        typedef std::char_traits<char> char_traits_type;
+    };
+}
+
+#endif // SHARDEDTARGET_HXX
@@ -0,0 +1,95 @@
+/*
+ * Drainer for shared memory log rings written by the ShmRingTarget (see
+ * shmringtarget.hxx for the ring layout). The producer only ever touches
+ * the mlocked ring; this tool runs as a separate process, tails the ring
+ * and writes the messages to stdout (redirect to persist them). Because
+ * the ring lives in the kernel, it can still be drained after the
+ * producer crashed.
+ *
+ * build e.g. with: g++ -std=c++11 -O2 -o shmlogreader shmlogreader.cpp -lrt
+ * usage: shmlogreader [-f] <shmname>    (-f: keep following the ring)
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "shmringtarget.hxx"
+
+int main(int argc, char **argv)
+{
+    bool follow = false;
+    char const *name = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-f") == 0) {
+            follow = true;
+        }
+        else {
+            name = argv[i];
+        }
+    }
+    if (!name) {
+        std::cerr << "usage: " << argv[0] << " [-f] <shmname>" << std::endl;
+        return 1;
+    }
+    int fd = ::shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        std::cerr << "could not open shm object " << name << std::endl;
+        return 1;
+    }
+    off_t size = ::lseek(fd, 0, SEEK_END);
+    void *map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        std::cerr << "could not map shm object " << name << std::endl;
+        return 1;
+    }
+    auto const *header = static_cast<Logging::ShmRing::RingHeader const *>(map);
+    if (std::memcmp(header->magic, Logging::ShmRing::MAGIC, sizeof(header->magic)) != 0) {
+        std::cerr << name << " is not a log ring" << std::endl;
+        return 1;
+    }
+    char const *slots = static_cast<char const *>(map)+sizeof(Logging::ShmRing::RingHeader);
+
+    std::uint64_t next = 1;
+    // a ring that already wrapped only holds the last slotCount messages
+    std::uint64_t head = header->head.load(std::memory_order_acquire);
+    if (head > header->slotCount) {
+        next = head-header->slotCount+1;
+        std::cout << "... " << next-1 << " messages already overwritten" << std::endl;
+    }
+    for (;;) {
+        head = header->head.load(std::memory_order_acquire);
+        if (next > head) {
+            if (!follow) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        if (head-next >= header->slotCount) {
+            // the producer lapped us - skip to the oldest surviving message
+            std::uint64_t oldest = head-header->slotCount+1;
+            std::cout << "... " << oldest-next << " messages overwritten" << std::endl;
+            next = oldest;
+        }
+        auto const *slot = reinterpret_cast<Logging::ShmRing::SlotHeader const *>(
+                    slots+((next-1)%header->slotCount)*header->slotSize);
+        if (slot->sequence.load(std::memory_order_acquire) == next) {
+            std::cout.write(reinterpret_cast<char const *>(slot)+sizeof(Logging::ShmRing::SlotHeader),
+                            slot->length);
+            std::cout << std::endl;
+        }
+        // a mismatching sequence means the slot was overwritten while we
+        // looked at it - the lap check above will resynchronize
+        ++next;
+    }
+    return 0;
+}
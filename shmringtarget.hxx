@@ -0,0 +1,336 @@
+#ifndef SHMRINGTARGET_HXX
+#define SHMRINGTARGET_HXX
+
+/*
+Copyright (c) 2014, Markus Brueckner <namenlos@geekbetrieb.de>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither my name nor the names of any contributors may be used to endorse
+      or promote products derived from this software without specific prior
+      written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL I, THE AUTHOR OF THIS SOFTWARE, BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "logging.hxx"
+#include "logging_utils.hxx"
+#include "locking.hxx"
+
+namespace Logging
+{
+    /**
+    * on-disk/in-memory layout of a shared memory log ring. Shared between
+    * the ShmRingTarget (producer side) and the shmlogreader drainer tool.
+    */
+    namespace ShmRing
+    {
+        /// header at offset 0 of the shared memory object
+        struct RingHeader
+        {
+            char magic[8];
+            std::uint32_t slotCount;
+            std::uint32_t slotSize;               // bytes per slot, including the SlotHeader
+            std::atomic<std::uint64_t> head;      // sequence number of the next message
+        };
+
+        /// header of each slot, followed by the message text
+        struct SlotHeader
+        {
+            std::atomic<std::uint64_t> sequence;  // 0: empty/in progress, else 1-based sequence
+            std::uint32_t length;                 // valid text bytes after the header
+            std::uint32_t reserved;
+        };
+
+        static constexpr char const *MAGIC = "SHMRING1";
+    }
+
+    /**
+    * Logging target writing formatted messages into a shared memory ring for
+    * services that cannot afford a syscall or page fault on the logging
+    * path. The ring (a POSIX shm object) is mapped, mlocked and pre-faulted
+    * at construction, so a message is a formatting pass plus a memcpy into
+    * the mapping - persistence is somebody else's problem: the shmlogreader
+    * tool (see shmlogreader.cpp) tails the ring from a separate process and
+    * writes it out.
+    *
+    * Each slot carries a sequence number that is published (release) only
+    * after the message bytes are in place, so the drainer never sees a half
+    * written message and the ring - living in the kernel, not the process -
+    * still holds the last slotCount messages after the producer crashes.
+    * Messages longer than a slot are truncated.
+    *
+    * \tparam LockType The type of Lock adapter to use. See OStreamTarget for the requirements.
+    */
+    template <typename LockType = NullLock> class ShmRingTarget : public LockType
+    {
+        int mFd;
+        std::size_t mSize;
+        ShmRing::RingHeader *mHeader;
+        std::string mBuffer;
+
+        ShmRing::SlotHeader *slot(std::uint64_t sequence)
+        {
+            char *base = reinterpret_cast<char *>(mHeader)+sizeof(ShmRing::RingHeader);
+            return reinterpret_cast<ShmRing::SlotHeader *>(
+                        base+((sequence-1)%mHeader->slotCount)*mHeader->slotSize);
+        }
+
+        /// write the common "(name) [LEVEL] " prefix into the assembly buffer
+        template <typename LoggerType> void startPrefix(LoggerType const &source, char const *level)
+        {
+            std::string const &logName = source.canonicalName();
+            if (logName.size() > 0) {
+                mBuffer += '(';
+                mBuffer += logName;
+                mBuffer += ") ";
+            }
+            mBuffer += '[';
+            mBuffer += level;
+            mBuffer += "] ";
+        }
+
+    public:
+
+        /**
+        * Constructor. Creates (or reattaches to) the shared memory ring and
+        * locks it into RAM. An existing ring with matching geometry is
+        * continued - a restarted producer keeps appending where the crashed
+        * run stopped.
+        *
+        * \param name The name of the POSIX shm object (e.g. "/mylog").
+        * \param slotCount The number of message slots the ring holds.
+        * \param slotSize The size of one slot in bytes, including its header.
+        */
+        explicit ShmRingTarget(char const *name, std::uint32_t slotCount = 4096,
+                               std::uint32_t slotSize = 512)
+            : mFd(::shm_open(name, O_RDWR|O_CREAT, 0644)),
+              mSize(sizeof(ShmRing::RingHeader)+static_cast<std::size_t>(slotCount)*slotSize),
+              mHeader(nullptr)
+        {
+            if (mFd < 0) {
+                throw std::runtime_error(std::string("could not open shm object ")+name);
+            }
+            ShmRing::RingHeader existing;
+            bool resume = ::read(mFd, &existing, sizeof(existing)) == sizeof(existing)
+                          && std::memcmp(existing.magic, ShmRing::MAGIC, sizeof(existing.magic)) == 0
+                          && existing.slotCount == slotCount && existing.slotSize == slotSize;
+            if (::ftruncate(mFd, mSize) != 0) {
+                ::close(mFd);
+                throw std::runtime_error(std::string("could not size shm object ")+name);
+            }
+            void *map = ::mmap(nullptr, mSize, PROT_READ|PROT_WRITE, MAP_SHARED, mFd, 0);
+            if (map == MAP_FAILED) {
+                ::close(mFd);
+                throw std::runtime_error(std::string("could not map shm object ")+name);
+            }
+            mHeader = static_cast<ShmRing::RingHeader *>(map);
+            // best effort - without the privilege for mlock the ring still
+            // works, it just may take page faults
+            ::mlock(map, mSize);
+            // pre-fault every page so the first messages do not pay for them
+            long pageSize = ::sysconf(_SC_PAGESIZE);
+            for (std::size_t offset = 0; offset < mSize; offset += pageSize) {
+                *(static_cast<volatile char *>(map)+offset) += 0;
+            }
+            if (!resume) {
+                mHeader->slotCount = slotCount;
+                mHeader->slotSize = slotSize;
+                mHeader->head.store(0, std::memory_order_relaxed);
+                for (std::uint64_t seq = 1; seq <= slotCount; ++seq) {
+                    slot(seq)->sequence.store(0, std::memory_order_relaxed);
+                }
+                // the magic goes in last: a drainer finding it may trust the rest
+                std::atomic_thread_fence(std::memory_order_release);
+                std::memcpy(mHeader->magic, ShmRing::MAGIC, sizeof(mHeader->magic));
+            }
+            mBuffer.reserve(slotSize);
+        }
+
+        ShmRingTarget(ShmRingTarget const &) = delete;
+        ShmRingTarget &operator=(ShmRingTarget const &) = delete;
+
+        /**
+        * Destructor. Detaches from the ring; the shm object stays around for
+        * the drainer (remove it with unlink() when it is no longer needed).
+        */
+        ~ShmRingTarget()
+        {
+            if (mHeader) {
+                ::munmap(mHeader, mSize);
+            }
+            if (mFd >= 0) {
+                ::close(mFd);
+            }
+        }
+
+        /**
+        * remove a ring's shm object from the system. Call once the producer
+        * and the drainer are both done with it.
+        *
+        * \param name The name the ring was created under.
+        */
+        static void unlink(char const *name)
+        {
+            ::shm_unlink(name);
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param tl the level of this message
+        * \note This method calls LockType::lock(). It might therefore block until the lock is available.
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, TraceLevel tl)
+        {
+            LockType::lock();
+            startPrefix(source, levelName(tl));
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param ll the level of this message
+        * \note This method calls LockType::lock(). It might therefore block until the lock is available.
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, LogLevel ll)
+        {
+            LockType::lock();
+            startPrefix(source, levelName(ll));
+        }
+
+        /**
+        * finish a message from the given source. The assembled text is
+        * copied into the next ring slot; the slot's sequence number is
+        * published only after the bytes are in place, so a crash between the
+        * two leaves an ignorable slot, never a torn message.
+        */
+        template <typename LoggerType> void endMessage(LoggerType const &)
+        {
+            std::size_t capacity = mHeader->slotSize-sizeof(ShmRing::SlotHeader);
+            std::size_t length = mBuffer.size() < capacity ? mBuffer.size() : capacity;
+            std::uint64_t sequence = mHeader->head.load(std::memory_order_relaxed)+1;
+            ShmRing::SlotHeader *s = slot(sequence);
+            s->sequence.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            s->length = static_cast<std::uint32_t>(length);
+            std::memcpy(reinterpret_cast<char *>(s)+sizeof(ShmRing::SlotHeader),
+                        mBuffer.data(), length);
+            s->sequence.store(sequence, std::memory_order_release);
+            mHeader->head.store(sequence, std::memory_order_release);
+            mBuffer.clear();  // keeps the capacity for the next message
+            LockType::unlock();
+        }
+
+        /// output a signed integral value to the assembly buffer
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<std::is_integral<ValueT>::value && std::is_signed<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            char buf[24];
+            int len = std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v));
+            mBuffer.append(buf, len);
+        }
+
+        /// output an unsigned integral value to the assembly buffer
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<std::is_integral<ValueT>::value && std::is_unsigned<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            char buf[24];
+            int len = std::snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(v));
+            mBuffer.append(buf, len);
+        }
+
+        /// output a floating point value to the assembly buffer
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<std::is_floating_point<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            char buf[32];
+            int len = std::snprintf(buf, sizeof(buf), "%g", static_cast<double>(v));
+            mBuffer.append(buf, len);
+        }
+
+        /// output a single character to the assembly buffer
+        template <typename LoggerType> void put(LoggerType const &, char const &v)
+        {
+            mBuffer += v;
+        }
+
+        /// output a C string to the assembly buffer
+        template <typename LoggerType> void put(LoggerType const &, char const * const &v)
+        {
+            mBuffer += v;
+        }
+
+        /// output a string to the assembly buffer
+        template <typename LoggerType> void put(LoggerType const &, std::string const &v)
+        {
+            mBuffer += v;
+        }
+
+        /// output any other value via iostream formatting
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<!std::is_arithmetic<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            std::ostringstream os;
+            os << v;
+            mBuffer += os.str();
+        }
+
+        /**
+        * Output stuff like std::endl to the buffer. std::endl degrades to a
+        * plain newline here; the slot is published in endMessage anyway.
+        *
+        * \param manip The manipulator to output.
+        */
+        void put(std::basic_ostream<char>& (*manip)(std::basic_ostream<char>&))
+        {
+            std::ostringstream os;
+            os << manip;
+            mBuffer += os.str();
+        }
+    };
+
+    /**
+     * traits specialization for the ShmRingTarget
+     */
+    template <typename LockType> struct TargetTraits<ShmRingTarget<LockType>>
+    {
+        typedef char char_type;
+        typedef std::char_traits<char> char_traits_type;
+    };
+}
+#endif // SHMRINGTARGET_HXX
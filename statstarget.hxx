@@ -0,0 +1,322 @@
+#ifndef STATSTARGET_HXX
+#define STATSTARGET_HXX
+
+/*
+Copyright (c) 2014, Markus Brueckner <namenlos@geekbetrieb.de>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither my name nor the names of any contributors may be used to endorse
+      or promote products derived from this software without specific prior
+      written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL I, THE AUTHOR OF THIS SOFTWARE, BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <mutex>
+
+#include "logging.hxx"
+
+namespace Logging
+{
+    /**
+    * Plain-struct copy of a latency distribution, as returned by the
+    * snapshot() calls below. Buckets hold power-of-two microsecond ranges:
+    * bucket 0 counts samples below 1us, bucket i those in [2^(i-1)us, 2^i us),
+    * the last bucket everything above.
+    */
+    struct LatencySnapshot
+    {
+        /// the number of latency buckets
+        static const std::size_t BUCKETS = 16;
+
+        /// number of recorded samples
+        unsigned long long count;
+        /// sum of all recorded samples, in nanoseconds
+        unsigned long long totalNanos;
+        /// largest recorded sample, in nanoseconds
+        unsigned long long maxNanos;
+        /// sample counts per power-of-two microsecond range
+        unsigned long long buckets[BUCKETS];
+    };
+
+    /**
+    * Lock-free latency recorder behind the snapshots: relaxed atomic
+    * counters only, so recording from the hot path costs a few uncontended
+    * increments. The counters are monotonically increasing; a snapshot is a
+    * consistent-enough copy for sizing buffers and spotting contention, not
+    * an atomic cut.
+    */
+    class LatencyRecorder
+    {
+        std::atomic<unsigned long long> mCount;
+        std::atomic<unsigned long long> mTotalNanos;
+        std::atomic<unsigned long long> mMaxNanos;
+        std::atomic<unsigned long long> mBuckets[LatencySnapshot::BUCKETS];
+
+    public:
+
+        LatencyRecorder()
+            : mCount(0), mTotalNanos(0), mMaxNanos(0)
+        {
+            for (std::size_t i = 0; i < LatencySnapshot::BUCKETS; ++i) {
+                mBuckets[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+        * record one sample.
+        *
+        * \param nanos The measured duration in nanoseconds.
+        */
+        void record(unsigned long long nanos)
+        {
+            mCount.fetch_add(1, std::memory_order_relaxed);
+            mTotalNanos.fetch_add(nanos, std::memory_order_relaxed);
+            unsigned long long seen = mMaxNanos.load(std::memory_order_relaxed);
+            while (nanos > seen
+                   && !mMaxNanos.compare_exchange_weak(seen, nanos, std::memory_order_relaxed)) {
+            }
+            std::size_t bucket = 0;
+            for (unsigned long long micros = nanos/1000;
+                 micros > 0 && bucket < LatencySnapshot::BUCKETS-1; micros >>= 1) {
+                ++bucket;
+            }
+            mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+        * copy the current state into a plain struct.
+        *
+        * \return the recorded distribution
+        */
+        LatencySnapshot snapshot() const
+        {
+            LatencySnapshot s;
+            s.count = mCount.load(std::memory_order_relaxed);
+            s.totalNanos = mTotalNanos.load(std::memory_order_relaxed);
+            s.maxNanos = mMaxNanos.load(std::memory_order_relaxed);
+            for (std::size_t i = 0; i < LatencySnapshot::BUCKETS; ++i) {
+                s.buckets[i] = mBuckets[i].load(std::memory_order_relaxed);
+            }
+            return s;
+        }
+    };
+
+    /**
+    * Lock adapter measuring how long callers block in lock(). Slots into
+    * any target's LockType parameter - e.g.
+    * <tt>OStreamTarget<std::ostream, InstrumentedLock<std::mutex>></tt> -
+    * and since the targets inherit their LockType, the measurements are
+    * available directly on the target via lockWaitSnapshot(). Use it to
+    * prove (or disprove) contention on a shared target; swap back to the
+    * plain LockType and the measuring code is gone, in the usual
+    * pay-for-what-you-use way of the lock policies.
+    *
+    * \tparam LockType The lock actually being acquired. Must provide
+    *                  lock()/unlock() like every LockType in this library.
+    */
+    template <typename LockType = std::mutex> class InstrumentedLock : public LockType
+    {
+        LatencyRecorder mWait;
+
+    public:
+
+        /// lock the underlying lock, recording the time spent blocked
+        void lock()
+        {
+            auto start = std::chrono::steady_clock::now();
+            LockType::lock();
+            mWait.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now()-start).count());
+        }
+
+        /**
+        * the lock-wait distribution since construction.
+        *
+        * \return a plain-struct copy of the recorded lock waits
+        */
+        LatencySnapshot lockWaitSnapshot() const
+        {
+            return mWait.snapshot();
+        }
+    };
+
+    /**
+    * Plain-struct copy of a StatsTarget's counters, as returned by
+    * StatsTarget::snapshot().
+    */
+    struct TargetStatsSnapshot
+    {
+        /// messages delivered, indexed by numeric level (LEVEL_TRACE..LEVEL_FATAL)
+        unsigned long long messagesByLevel[6];
+        /// messages delivered in total
+        unsigned long long totalMessages;
+        /// distribution of the full startMessage-to-endMessage time
+        LatencySnapshot messageLatency;
+    };
+
+    /**
+    * Pseudo-target counting the traffic that flows through it. Wraps any
+    * target (like the other pseudo-targets) and maintains relaxed atomic
+    * per-level message counters plus a histogram of the full
+    * startMessage-to-endMessage time - the number that tells you how long
+    * logging actually blocks the calling thread, lock wait and write
+    * included. Wrap the target of a logger subtree to meter that subtree;
+    * combine with InstrumentedLock on the sub-target to split the message
+    * time into lock wait and the rest.
+    *
+    * The stats layer is opt-in by construction: deployments that do not
+    * wrap their target (or use the plain LockType) contain no counting code
+    * at all.
+    *
+    * \tparam SubTarget The target type actually delivering the messages.
+    */
+    template <typename SubTarget> class StatsTarget
+    {
+        std::shared_ptr<SubTarget> mSubTarget;
+        std::atomic<unsigned long long> mMessagesByLevel[6];
+        LatencyRecorder mMessageLatency;
+
+        /// when the message the calling thread currently builds was started
+        static std::int64_t &startNanos()
+        {
+            static thread_local std::int64_t t = 0;
+            return t;
+        }
+
+        static std::int64_t nowNanos()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void count(unsigned char level)
+        {
+            if (level < 6) {
+                mMessagesByLevel[level].fetch_add(1, std::memory_order_relaxed);
+            }
+            startNanos() = nowNanos();
+        }
+
+    public:
+
+        /**
+        * Constructor.
+        *
+        * \param subTarget The target delivering the counted messages.
+        */
+        StatsTarget(std::shared_ptr<SubTarget> const &subTarget)
+            : mSubTarget(subTarget)
+        {
+            for (std::size_t i = 0; i < 6; ++i) {
+                mMessagesByLevel[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param tl the level of this message
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, TraceLevel tl)
+        {
+            count(tl);
+            mSubTarget->startMessage(source, tl);
+        }
+
+        /**
+        * Start a message from the given logger with the given level.
+        *
+        * \param source the logger object, which starts the message.
+        * \param ll the level of this message
+        */
+        template <typename LoggerType> void startMessage(LoggerType const &source, LogLevel ll)
+        {
+            count(ll);
+            mSubTarget->startMessage(source, ll);
+        }
+
+        /**
+        * finish a message from the given source and record the time the
+        * whole message took the calling thread.
+        */
+        template <typename LoggerType> void endMessage(LoggerType const &source)
+        {
+            mSubTarget->endMessage(source);
+            mMessageLatency.record(nowNanos()-startNanos());
+        }
+
+        /**
+        * output a value. The value's category is preserved, so the wrapped
+        * target may move from temporaries.
+        *
+        * \param v The value to forward to the wrapped target.
+        */
+        template <typename LoggerType, typename ValueT> void put(LoggerType const &source, ValueT &&v)
+        {
+            mSubTarget->put(source, std::forward<ValueT>(v));
+        }
+
+        /**
+        * Output stuff like std::endl.
+        *
+        * \param manip The manipulator to forward.
+        */
+        void put(std::basic_ostream<char>& (*manip)(std::basic_ostream<char>&))
+        {
+            mSubTarget->put(manip);
+        }
+
+        /**
+        * copy the current counters into a plain struct.
+        *
+        * \return the traffic seen since construction
+        */
+        TargetStatsSnapshot snapshot() const
+        {
+            TargetStatsSnapshot s;
+            s.totalMessages = 0;
+            for (std::size_t i = 0; i < 6; ++i) {
+                s.messagesByLevel[i] = mMessagesByLevel[i].load(std::memory_order_relaxed);
+                s.totalMessages += s.messagesByLevel[i];
+            }
+            s.messageLatency = mMessageLatency.snapshot();
+            return s;
+        }
+    };
+
+    /**
+    * traits specialization for the StatsTarget. As with the other wrapper
+    * targets, only the common char-output can be promised.
+    */
+    template <typename SubTarget> struct TargetTraits<StatsTarget<SubTarget>>
+    {
+        typedef char char_type;
+        typedef std::char_traits<char> char_traits_type;
+    };
+}
+
+#endif // STATSTARGET_HXX
@@ -2,12 +2,16 @@
 #define SYSLOGTARGET_HXX
 
 #include <sstream>
+#include <string>
+#include <cstdio>
+#include <type_traits>
 
 #include <syslog.h>
 
 #include "logging.hxx"
 #include "logging_utils.hxx"
 #include "locking.hxx"
+#include "textencoding.hxx"
 
 namespace Logging
 {
@@ -16,46 +20,65 @@ namespace Logging
         int mOption;
         int mFacility;
         int mLevel;
-        std::stringstream mOs;
         /**
-         * store the logger names internally in order to make it a) more
-         *  efficient and b) have them survive long enough from the 
-         *  openlog to the syslog call.
-         * The key type is void const * const, as this map cannot know anything about
-         *  the actual logger type and it doesn't need to, as the pointer is just used
-         *  as an index.
+         * flat assembly buffer for the current message. Cleared but never
+         * deallocated between messages, so after the first few messages the
+         * whole formatting path runs without heap allocations - unlike the
+         * std::stringstream used before, which allocated a fresh string for
+         * every message in str().
          */
-        std::map<void const * const, std::string> mLoggerNames; 
-        
-        template <typename LoggerType> char const *loggerName(LoggerType const * const l)
+        std::string mBuffer;
+        /// reused scratch for messages that contain control characters
+        std::string mSanitized;
+        /**
+         * write the common "(name) [LEVEL] " prefix into the assembly
+         * buffer. The logger name is part of the message body now - idents
+         * belong to the process, not to individual loggers, and switching
+         * them per message cost an openlog() call each time.
+         */
+        template <typename LoggerType> void startPrefix(LoggerType const &source, char const *level)
         {
-            auto i = mLoggerNames.find(l); // we just index by the pointer, as the logger instances should be constant anyway
-            if (i == mLoggerNames.end()) {
-                i = mLoggerNames.insert(std::make_pair(l, canonicalName(*l).c_str())).first;
+            if (detail::WantsLoggerName<typename LoggerType::TargetTraitsType>::value) {
+                std::string const &logName = source.canonicalName();
+                if (logName.size() > 0) {
+                    mBuffer += '(';
+                    mBuffer += logName;
+                    mBuffer += ") ";
+                }
             }
-            return i->second.c_str();
+            mBuffer += '[';
+            mBuffer += level;
+            mBuffer += "] ";
         }
-        
+
     public:
-        
-        SyslogTarget(int option = LOG_CONS, int facility = LOG_USER)
+
+        /**
+        * Constructor. Opens the syslog connection once; all messages of this
+        * target share the given ident.
+        *
+        * \param ident The ident string syslog prefixes every message with.
+        *              nullptr (the default) lets syslog use the program name.
+        * \param option Options passed to openlog (see syslog(3)).
+        * \param facility The syslog facility to log under.
+        */
+        SyslogTarget(char const *ident = nullptr, int option = LOG_CONS, int facility = LOG_USER)
             : mOption(option), mFacility(facility)
         {
-        }        
-        
+            openlog(ident, mOption, mFacility);
+        }
+
         template <typename LoggerType> void startMessage(LoggerType const &source, TraceLevel tl)
         {
             LockType::lock();
-            openlog(loggerName(&source), mOption, mFacility);
-            mOs << '[' << levelName(tl) << "] ";
+            startPrefix(source, levelName(tl));
             mLevel = tl;
         }
-        
+
         template <typename LoggerType> void startMessage(LoggerType const &source, LogLevel ll)
         {
             LockType::lock();
-            openlog(loggerName(&source), mOption, mFacility);
-            mOs << '[' << levelName(ll) << "] ";
+            startPrefix(source, levelName(ll));
             mLevel = ll;
         }
         
@@ -83,30 +106,108 @@ namespace Logging
                 level = LOG_EMERG;
                 break;
             }
-            syslog(level, "%s", mOs.str().c_str());
-            mOs.str(std::string());
+            // syslog treats the message as one record: drop the meaningless
+            // trailing newline from "<< std::endl" and escape any interior
+            // control characters, which syslogd would otherwise mangle. The
+            // vectorized scan makes the common control-free message a single
+            // sweep over the buffer with no copy.
+            std::size_t size = mBuffer.size();
+            while (size > 0 && mBuffer[size-1] == '\n') {
+                --size;
+            }
+            if (TextEncoding::findControl(mBuffer.data(), size) == size) {
+                mBuffer.resize(size);
+                syslog(level, "%s", mBuffer.c_str());
+            }
+            else {
+                mSanitized.clear();  // keeps the capacity
+                TextEncoding::appendSanitized(mSanitized, mBuffer.data(), size);
+                syslog(level, "%s", mSanitized.c_str());
+            }
+            mBuffer.clear();  // keeps the capacity for the next message
             LockType::unlock();
         }
-        
+
         /**
-        * output a value to the underlying stream.
-        * 
-        * \param v The value. This method has the same effect as <tt>os << v</tt> (with os being the underlying
-        *          std::ostringstream.
+        * output a signed integral value to the assembly buffer. Formatted
+        * directly into a stack buffer instead of going through iostreams.
         */
-        template <typename LoggerType, typename ValueT> void put(LoggerType const &, ValueT const &v)
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<std::is_integral<ValueT>::value && std::is_signed<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
         {
-            mOs << v;
+            char buf[24];
+            int len = std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v));
+            mBuffer.append(buf, len);
         }
-        
+
+        /**
+        * output an unsigned integral value to the assembly buffer.
+        */
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<std::is_integral<ValueT>::value && std::is_unsigned<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            char buf[24];
+            int len = std::snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(v));
+            mBuffer.append(buf, len);
+        }
+
+        /**
+        * output a floating point value to the assembly buffer.
+        */
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<std::is_floating_point<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            char buf[32];
+            int len = std::snprintf(buf, sizeof(buf), "%g", static_cast<double>(v));
+            mBuffer.append(buf, len);
+        }
+
+        /// output a single character to the assembly buffer
+        template <typename LoggerType> void put(LoggerType const &, char const &v)
+        {
+            mBuffer += v;
+        }
+
+        /// output a C string to the assembly buffer
+        template <typename LoggerType> void put(LoggerType const &, char const * const &v)
+        {
+            mBuffer += v;
+        }
+
+        /// output a string to the assembly buffer
+        template <typename LoggerType> void put(LoggerType const &, std::string const &v)
+        {
+            mBuffer += v;
+        }
+
+        /**
+        * output any other value to the assembly buffer. Values without a
+        * direct conversion above fall back to iostream formatting; only this
+        * fallback still pays for a stringstream.
+        */
+        template <typename LoggerType, typename ValueT>
+            typename std::enable_if<!std::is_arithmetic<ValueT>::value>::type
+                put(LoggerType const &, ValueT const &v)
+        {
+            std::ostringstream os;
+            os << v;
+            mBuffer += os.str();
+        }
+
         /**
-        * Output stuff like std::endl to the underlying stream.
-        * 
-        * \param manip The manipulator to output to the underlying stream.
+        * Output stuff like std::endl to the buffer. std::endl degrades to a
+        * plain newline here, as there is no stream to flush.
+        *
+        * \param manip The manipulator to output.
         */
         void put(std::basic_ostream<char>& (*manip)(std::basic_ostream<char>&))
         {
-            mOs << manip;
+            std::ostringstream os;
+            os << manip;
+            mBuffer += os.str();
         }
     };
     
@@ -0,0 +1,254 @@
+#ifndef TEXTENCODING_HXX
+#define TEXTENCODING_HXX
+
+/*
+Copyright (c) 2014, Markus Brueckner <namenlos@geekbetrieb.de>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither my name nor the names of any contributors may be used to endorse
+      or promote products derived from this software without specific prior
+      written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL I, THE AUTHOR OF THIS SOFTWARE, BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Logging
+{
+    /**
+    * Byte-level text routines for message bodies: finding newlines and
+    * characters that need escaping, and appending escaped text. The scans
+    * process 16 bytes per step on SSE2 hardware (selected at compile time
+    * via __SSE2__, with a plain scalar fallback elsewhere) - on the typical
+    * message, which needs no escaping at all, the cost is one vector sweep
+    * over the text instead of a byte-at-a-time loop. The targets use these
+    * internally; custom targets built on the put() protocol (JSON encoders
+    * and the like) are welcome to reuse them.
+    */
+    namespace TextEncoding
+    {
+#ifdef __SSE2__
+        namespace detail
+        {
+            /// index of the first set mask bit, for the 16-bit movemask results
+            inline std::size_t firstBit(int mask)
+            {
+                return __builtin_ctz(mask);
+            }
+        }
+#endif
+
+        /**
+        * find the first occurrence of a byte, memchr-style.
+        *
+        * \param data The text to scan.
+        * \param size The number of bytes to scan.
+        * \param value The byte to look for.
+        * \return the index of the first occurrence, or size if there is none
+        */
+        inline std::size_t findByte(char const *data, std::size_t size, char value)
+        {
+            std::size_t i = 0;
+#ifdef __SSE2__
+            __m128i needle = _mm_set1_epi8(value);
+            for (; i+16 <= size; i += 16) {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data+i));
+                int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+                if (mask != 0) {
+                    return i+detail::firstBit(mask);
+                }
+            }
+#endif
+            for (; i < size; ++i) {
+                if (data[i] == value) {
+                    return i;
+                }
+            }
+            return size;
+        }
+
+        /**
+        * find the first control character (byte value below 0x20).
+        *
+        * \param data The text to scan.
+        * \param size The number of bytes to scan.
+        * \return the index of the first control character, or size if there is none
+        */
+        inline std::size_t findControl(char const *data, std::size_t size)
+        {
+            std::size_t i = 0;
+#ifdef __SSE2__
+            // min_epu8(v, 0x1f) == v holds exactly for the unsigned bytes <= 0x1f
+            __m128i limit = _mm_set1_epi8(0x1f);
+            for (; i+16 <= size; i += 16) {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data+i));
+                int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(chunk, limit), chunk));
+                if (mask != 0) {
+                    return i+detail::firstBit(mask);
+                }
+            }
+#endif
+            for (; i < size; ++i) {
+                if (static_cast<unsigned char>(data[i]) < 0x20) {
+                    return i;
+                }
+            }
+            return size;
+        }
+
+        /**
+        * find the first byte a JSON string encoder has to escape: control
+        * characters, the double quote and the backslash.
+        *
+        * \param data The text to scan.
+        * \param size The number of bytes to scan.
+        * \return the index of the first such byte, or size if there is none
+        */
+        inline std::size_t findEscapable(char const *data, std::size_t size)
+        {
+            std::size_t i = 0;
+#ifdef __SSE2__
+            __m128i limit = _mm_set1_epi8(0x1f);
+            __m128i quote = _mm_set1_epi8('"');
+            __m128i backslash = _mm_set1_epi8('\\');
+            for (; i+16 <= size; i += 16) {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data+i));
+                __m128i hits = _mm_or_si128(
+                        _mm_cmpeq_epi8(_mm_min_epu8(chunk, limit), chunk),
+                        _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                     _mm_cmpeq_epi8(chunk, backslash)));
+                int mask = _mm_movemask_epi8(hits);
+                if (mask != 0) {
+                    return i+detail::firstBit(mask);
+                }
+            }
+#endif
+            for (; i < size; ++i) {
+                unsigned char c = static_cast<unsigned char>(data[i]);
+                if (c < 0x20 || c == '"' || c == '\\') {
+                    return i;
+                }
+            }
+            return size;
+        }
+
+        /**
+        * append text with control characters replaced by readable escapes
+        * (\\n, \\r, \\t, \\xNN for the rest), for sinks that treat the byte
+        * stream as a single line - a syslog record, for instance. Clean runs
+        * between the escapes are located with the vectorized scan and copied
+        * in bulk.
+        *
+        * \param out The string to append to.
+        * \param data The text to append.
+        * \param size The number of bytes to append.
+        */
+        inline void appendSanitized(std::string &out, char const *data, std::size_t size)
+        {
+            while (size > 0) {
+                std::size_t clean = findControl(data, size);
+                out.append(data, clean);
+                if (clean == size) {
+                    return;
+                }
+                switch (data[clean]) {
+                case '\n':
+                    out += "\\n";
+                    break;
+                case '\r':
+                    out += "\\r";
+                    break;
+                case '\t':
+                    out += "\\t";
+                    break;
+                default: {
+                    char buf[5];
+                    std::snprintf(buf, sizeof(buf), "\\x%02x",
+                                  static_cast<unsigned char>(data[clean]));
+                    out += buf;
+                    break;
+                }
+                }
+                data += clean+1;
+                size -= clean+1;
+            }
+        }
+
+        /**
+        * append text escaped for use inside a JSON string literal. Clean
+        * runs between the escapes are located with the vectorized scan and
+        * copied in bulk.
+        *
+        * \param out The string to append to.
+        * \param data The text to append.
+        * \param size The number of bytes to append.
+        */
+        inline void appendJsonEscaped(std::string &out, char const *data, std::size_t size)
+        {
+            while (size > 0) {
+                std::size_t clean = findEscapable(data, size);
+                out.append(data, clean);
+                if (clean == size) {
+                    return;
+                }
+                switch (data[clean]) {
+                case '"':
+                    out += "\\\"";
+                    break;
+                case '\\':
+                    out += "\\\\";
+                    break;
+                case '\b':
+                    out += "\\b";
+                    break;
+                case '\f':
+                    out += "\\f";
+                    break;
+                case '\n':
+                    out += "\\n";
+                    break;
+                case '\r':
+                    out += "\\r";
+                    break;
+                case '\t':
+                    out += "\\t";
+                    break;
+                default: {
+                    char buf[7];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x",
+                                  static_cast<unsigned char>(data[clean]));
+                    out += buf;
+                    break;
+                }
+                }
+                data += clean+1;
+                size -= clean+1;
+            }
+        }
+    }
+}
+
+#endif // TEXTENCODING_HXX